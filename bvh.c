@@ -0,0 +1,196 @@
+#include "bvh.h"
+
+#include <assert.h>
+
+// 質がこの割合まで落ちたら作り直す
+#define BVH_REBUILD_RATIO 1.3f
+// 深さ d の木をたどると, 積まれるのは各段の兄弟と最後の2つで d + 1 個まで
+#define BVH_STACK (BVH_MAX_DEPTH + 1)
+
+static Aabb Union(Aabb a, Aabb b) {
+  Aabb u;
+  u.min_x = a.min_x < b.min_x ? a.min_x : b.min_x;
+  u.min_y = a.min_y < b.min_y ? a.min_y : b.min_y;
+  u.max_x = a.max_x > b.max_x ? a.max_x : b.max_x;
+  u.max_y = a.max_y > b.max_y ? a.max_y : b.max_y;
+  return u;
+}
+
+static bool Equal(Aabb a, Aabb b) {
+  return a.min_x == b.min_x && a.min_y == b.min_y && a.max_x == b.max_x &&
+         a.max_y == b.max_y;
+}
+
+static bool Contains(Aabb outer, Aabb inner) {
+  return outer.min_x <= inner.min_x && outer.min_y <= inner.min_y &&
+         outer.max_x >= inner.max_x && outer.max_y >= inner.max_y;
+}
+
+static Aabb Fatten(Aabb a, float margin) {
+  return (Aabb){a.min_x - margin, a.min_y - margin, a.max_x + margin,
+                a.max_y + margin};
+}
+
+static float Perimeter(Aabb a) {
+  return 2.0f * ((a.max_x - a.min_x) + (a.max_y - a.min_y));
+}
+
+static float Center(const Aabb *a, int axis) {
+  return axis == 0 ? a->min_x + a->max_x : a->min_y + a->max_y;
+}
+
+// idx[k] に中心が k 番目に小さい要素が来るように並べる (クイックセレクト)
+static void Select(int *idx, int n, int k, const Aabb *items, int axis) {
+  int lo = 0;
+  int hi = n - 1;
+  while (lo < hi) {
+    float pivot = Center(&items[idx[(lo + hi) / 2]], axis);
+    int i = lo;
+    int j = hi;
+    while (i <= j) {
+      while (Center(&items[idx[i]], axis) < pivot)
+        i++;
+      while (Center(&items[idx[j]], axis) > pivot)
+        j--;
+      if (i <= j) {
+        int tmp = idx[i];
+        idx[i] = idx[j];
+        idx[j] = tmp;
+        i++;
+        j--;
+      }
+    }
+    if (k <= j)
+      hi = j;
+    else if (k >= i)
+      lo = i;
+    else
+      break;
+  }
+}
+
+static int BuildRange(Bvh bvh, const Aabb *items, int *idx, int n, int parent,
+                      int depth, int *next) {
+  int node = (*next)++;
+  bvh.nodes[node].parent = parent;
+  if (depth > bvh.info->depth)
+    bvh.info->depth = depth;
+  if (n == 1) {
+    bvh.nodes[node].left = -1;
+    bvh.nodes[node].right = idx[0];
+    bvh.nodes[node].box = Fatten(items[idx[0]], bvh.info->margin);
+    bvh.leaf_of[idx[0]] = node;
+    return node;
+  }
+
+  // 中心の広がりが大きい軸で半分に分ける
+  float min_c[2] = {Center(&items[idx[0]], 0), Center(&items[idx[0]], 1)};
+  float max_c[2] = {min_c[0], min_c[1]};
+  for (int i = 1; i < n; i++) {
+    for (int axis = 0; axis < 2; axis++) {
+      float c = Center(&items[idx[i]], axis);
+      if (c < min_c[axis])
+        min_c[axis] = c;
+      if (c > max_c[axis])
+        max_c[axis] = c;
+    }
+  }
+  int axis = (max_c[0] - min_c[0]) >= (max_c[1] - min_c[1]) ? 0 : 1;
+  int mid = n / 2;
+  Select(idx, n, mid, items, axis);
+
+  int left = BuildRange(bvh, items, idx, mid, node, depth + 1, next);
+  int right =
+      BuildRange(bvh, items, idx + mid, n - mid, node, depth + 1, next);
+  bvh.nodes[node].left = left;
+  bvh.nodes[node].right = right;
+  bvh.nodes[node].box = Union(bvh.nodes[left].box, bvh.nodes[right].box);
+  return node;
+}
+
+static float TreeCost(Bvh bvh) {
+  if (bvh.info->root < 0)
+    return 0.0f;
+  float root = Perimeter(bvh.nodes[bvh.info->root].box);
+  if (root <= 0.0f)
+    return 0.0f;
+  float sum = 0.0f;
+  for (int i = 0; i < 2 * bvh.info->count - 1; i++) {
+    if (bvh.nodes[i].left >= 0)
+      sum += Perimeter(bvh.nodes[i].box);
+  }
+  return sum / root;
+}
+
+void BvhBuild(Bvh bvh, const Aabb *items, int count, float margin,
+              int *scratch) {
+  bvh.info->count = count;
+  bvh.info->margin = margin;
+  bvh.info->root = -1;
+  bvh.info->depth = 0;
+  if (count > 0) {
+    for (int i = 0; i < count; i++)
+      scratch[i] = i;
+    int next = 0;
+    bvh.info->root = BuildRange(bvh, items, scratch, count, -1, 1, &next);
+  }
+  // 半分ずつに分けるので深さは log2(count) + 1 段. ここを超えることはない
+  assert(bvh.info->depth <= BVH_MAX_DEPTH);
+  bvh.info->build_cost = TreeCost(bvh);
+  bvh.info->cost = bvh.info->build_cost;
+  bvh.info->rebuilds++;
+}
+
+// 葉の箱からはみ出した要素だけ箱を作り直し, 親をたどって子の和に合わせる.
+// 親の箱が変わらなければその上も変わらないのでそこで止める.
+// 親は常にぴったりなので, cost が上がるのは兄弟が離れたときだけで,
+// 作り直しの判断はそれだけを見ることになる
+void BvhUpdate(Bvh bvh, const Aabb *items, int *scratch) {
+  bool changed = false;
+  for (int i = 0; i < bvh.info->count; i++) {
+    int leaf = bvh.leaf_of[i];
+    if (Contains(bvh.nodes[leaf].box, items[i]))
+      continue;
+    bvh.nodes[leaf].box = Fatten(items[i], bvh.info->margin);
+    changed = true;
+    for (int p = bvh.nodes[leaf].parent; p >= 0; p = bvh.nodes[p].parent) {
+      Aabb u = Union(bvh.nodes[bvh.nodes[p].left].box,
+                     bvh.nodes[bvh.nodes[p].right].box);
+      if (Equal(bvh.nodes[p].box, u))
+        break;
+      bvh.nodes[p].box = u;
+    }
+  }
+  if (!changed)
+    return;
+  bvh.info->refits++;
+  bvh.info->cost = TreeCost(bvh);
+  if (bvh.info->cost > bvh.info->build_cost * BVH_REBUILD_RATIO) {
+    BvhBuild(bvh, items, bvh.info->count, bvh.info->margin, scratch);
+  }
+}
+
+int BvhQuery(const BvhNode *nodes, const BvhInfo *info, Aabb box, int *out,
+             int max_out) {
+  if (info->root < 0)
+    return 0;
+  // 深さから必要なスタックの大きさが決まるので, 部分木を黙って飛ばすことはない
+  assert(info->depth + 1 <= BVH_STACK);
+  int stack[BVH_STACK];
+  int top = 0;
+  int found = 0;
+  stack[top++] = info->root;
+  while (top > 0) {
+    const BvhNode *node = &nodes[stack[--top]];
+    if (!AabbOverlap(node->box, box))
+      continue;
+    if (node->left < 0) {
+      if (found < max_out)
+        out[found++] = node->right;
+      continue;
+    }
+    stack[top++] = node->right;
+    stack[top++] = node->left;
+  }
+  return found;
+}
@@ -0,0 +1,62 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdbool.h>
+
+// 動くブロック用の境界ボリューム階層 (2D の AABB 木).
+// 葉の箱は余白付きで持ち, 中身がその箱からはみ出したときだけ親へ向かって
+// 箱を子の和に合わせ直す (広げるだけでなく縮めもする). 木の形は変えないので,
+// 兄弟どうしが離れていって質が落ちたら作り直す.
+
+typedef struct {
+  float min_x;
+  float min_y;
+  float max_x;
+  float max_y;
+} Aabb;
+
+typedef struct {
+  Aabb box;
+  int parent;
+  // 葉なら left = -1, right = 要素番号
+  int left;
+  int right;
+} BvhNode;
+
+typedef struct {
+  int root;
+  int count;
+  // 根から一番深い葉までの段数 (根だけなら 1). 作り直すときだけ変わる
+  int depth;
+  // 葉の箱に付ける余白
+  float margin;
+  // 中間ノードの周長の合計 / 根の周長. 作り直した直後の値と比べて質を判断する
+  float build_cost;
+  float cost;
+  int refits;
+  int rebuilds;
+} BvhInfo;
+
+// 記憶領域は呼び出し側が持つ (nodes は 2 * count, leaf_of は count 要素)
+typedef struct {
+  BvhNode *nodes;
+  int *leaf_of;
+  BvhInfo *info;
+} Bvh;
+
+void BvhBuild(Bvh bvh, const Aabb *items, int count, float margin,
+              int *scratch);
+void BvhUpdate(Bvh bvh, const Aabb *items, int *scratch);
+// 木を読むだけなので, 更新中でなければ複数のスレッドから同時に呼んでよい.
+// 探索に使うスタックは BVH_MAX_DEPTH 段分 (中央で分けて作るので, int で
+// 数えられる要素数なら足りる)
+#define BVH_MAX_DEPTH 64
+int BvhQuery(const BvhNode *nodes, const BvhInfo *info, Aabb box, int *out,
+             int max_out);
+
+static inline bool AabbOverlap(Aabb a, Aabb b) {
+  return a.min_x <= b.max_x && b.min_x <= a.max_x && a.min_y <= b.max_y &&
+         b.min_y <= a.max_y;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <assert.h>
+#include <stdint.h>
+
+// Q16.16 の固定小数点数. 整数演算だけで計算するので, コンパイラや
+// 最適化オプション (-ffast-math 等), CPU が違っても結果が一致する.
+// 表せる範囲は約 ±32767 (画面座標と秒数には十分).
+typedef int32_t Fixed;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+// 定数用. 定数式として畳み込まれるので実行時の浮動小数点演算は残らない
+#define FIXED_CONST(x)                                                         \
+  ((Fixed)((x) * 65536.0 + ((x) >= 0 ? 0.5 : -0.5)))
+
+static inline Fixed FixedFromInt(int v) { return (Fixed)(v * FIXED_ONE); }
+
+// 浮動小数点の入力 (dt など) を受け取るとき用. 2 のべき乗倍のあと,
+// 0.5 を 0 から遠い方へ足して切り捨てる (四捨五入) だけなので,
+// 同じ float からは常に同じ値になる
+static inline Fixed FixedFromFloat(float v) {
+  float scaled = v * 65536.0f;
+  return (Fixed)(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+}
+
+static inline float FixedToFloat(Fixed v) { return (float)v / 65536.0f; }
+
+// v / 2^16 を負の無限大方向へ丸める. 負の数の右シフトは処理系定義なので,
+// 2^62 を足して非負にしてから符号なしでシフトし, 足した分を引き戻す.
+// 2^62 は 2^16 の倍数なので丸めは変わらない. int32 どうしの積なら
+// |v| <= 2^62 で桁あふれしない. 分岐がないのでループはベクトル化できる
+#define FIXED_SHIFT_BIAS ((uint64_t)1 << 62)
+static inline int64_t FixedShiftFloor(int64_t v) {
+  return (int64_t)(((uint64_t)v + FIXED_SHIFT_BIAS) >> FIXED_SHIFT) -
+         (int64_t)(FIXED_SHIFT_BIAS >> FIXED_SHIFT);
+}
+
+// 端数は負の無限大方向へ丸める
+static inline Fixed FixedMul(Fixed a, Fixed b) {
+  return (Fixed)FixedShiftFloor((int64_t)a * b);
+}
+
+// 0 で割るのは呼び出し側の誤り. assert を外したビルドでも落ちずに同じ結果に
+// なるよう, 符号に合わせて表せる端の値を返す
+static inline Fixed FixedDiv(Fixed a, Fixed b) {
+  assert(b != 0);
+  if (b == 0)
+    return a < 0 ? INT32_MIN : INT32_MAX;
+  return (Fixed)(((int64_t)a * FIXED_ONE) / b);
+}
+
+static inline Fixed FixedAbs(Fixed v) { return v < 0 ? -v : v; }
+
+Fixed FixedSqrt(Fixed v);
+// 角度はラジアン. 1 周 1024 分割の表を線形補間する
+Fixed FixedSin(Fixed angle);
+Fixed FixedCos(Fixed angle);
+
+#endif
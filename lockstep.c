@@ -0,0 +1,402 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "lockstep.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PACKET_HELLO 1
+#define PACKET_WELCOME 2
+#define PACKET_INPUT 3
+#define PACKET_QUIT 4
+
+#define LOCKSTEP_MAGIC 0x504f4e47u
+#define HELLO_INTERVAL_US 100000
+#define TIMEOUT_US 5000000
+// 遅延を下げるのは目標値を下回った状態がこれだけ続いてから (約2秒)
+#define DELAY_LOWER_TICKS 120
+#define PACKET_MAX 512
+
+static uint64_t NowMicros(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void Put8(uint8_t *buf, int *len, uint8_t v) { buf[(*len)++] = v; }
+
+static void Put16(uint8_t *buf, int *len, uint16_t v) {
+  Put8(buf, len, (uint8_t)v);
+  Put8(buf, len, (uint8_t)(v >> 8));
+}
+
+static void Put32(uint8_t *buf, int *len, uint32_t v) {
+  Put16(buf, len, (uint16_t)v);
+  Put16(buf, len, (uint16_t)(v >> 16));
+}
+
+static void Put64(uint8_t *buf, int *len, uint64_t v) {
+  Put32(buf, len, (uint32_t)v);
+  Put32(buf, len, (uint32_t)(v >> 32));
+}
+
+static uint32_t Get32(const uint8_t *buf) {
+  return (uint32_t)buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 |
+         (uint32_t)buf[3] << 24;
+}
+
+static uint64_t Get64(const uint8_t *buf) {
+  return (uint64_t)Get32(buf) | (uint64_t)Get32(buf + 4) << 32;
+}
+
+static void Reset(Lockstep *ls) {
+  memset(ls, 0, sizeof(*ls));
+  ls->sock = -1;
+  ls->delay = LOCKSTEP_MIN_DELAY;
+  ls->remote_last = -1;
+  ls->remote_acked = -1;
+  ls->last_hash_frame = -1;
+  ls->desync_frame = -1;
+  for (int i = 0; i < LOCKSTEP_HASH_SLOTS; i++) {
+    ls->local_hash_frame[i] = -1;
+    ls->remote_hash_frame[i] = -1;
+  }
+  // 最初の delay フレームは双方とも無入力で埋めておく
+  ls->local_last = ls->delay - 1;
+}
+
+static bool OpenSocket(Lockstep *ls, uint16_t port) {
+  ls->sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (ls->sock < 0) {
+    perror("socket");
+    return false;
+  }
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(ls->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("bind");
+    close(ls->sock);
+    ls->sock = -1;
+    return false;
+  }
+  fcntl(ls->sock, F_SETFL, fcntl(ls->sock, F_GETFL, 0) | O_NONBLOCK);
+  return true;
+}
+
+bool LockstepHost(Lockstep *ls, uint16_t port, uint32_t seed) {
+  Reset(ls);
+  ls->is_host = true;
+  ls->player = 0;
+  ls->seed = seed;
+  return OpenSocket(ls, port);
+}
+
+bool LockstepJoin(Lockstep *ls, const char *host, uint16_t port) {
+  Reset(ls);
+  ls->is_host = false;
+  ls->player = 1;
+  struct addrinfo hints = {0};
+  struct addrinfo *res = NULL;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  if (getaddrinfo(host, NULL, &hints, &res) != 0 || res == NULL) {
+    fprintf(stderr, "lockstep: cannot resolve '%s'\n", host);
+    return false;
+  }
+  memcpy(&ls->peer, res->ai_addr, sizeof(ls->peer));
+  ls->peer.sin_port = htons(port);
+  freeaddrinfo(res);
+  return OpenSocket(ls, 0);
+}
+
+static void SendRaw(Lockstep *ls, const uint8_t *buf, int len) {
+  ssize_t n = sendto(ls->sock, buf, (size_t)len, 0,
+                     (const struct sockaddr *)&ls->peer, sizeof(ls->peer));
+  if (n == len) {
+    ls->packets_sent++;
+    ls->bytes_sent += (uint64_t)len;
+  }
+}
+
+void LockstepClose(Lockstep *ls) {
+  if (ls->sock < 0)
+    return;
+  if (ls->status == LOCKSTEP_RUNNING) {
+    uint8_t buf[1] = {PACKET_QUIT};
+    SendRaw(ls, buf, 1);
+  }
+  close(ls->sock);
+  ls->sock = -1;
+  ls->status = LOCKSTEP_DISCONNECTED;
+}
+
+static void SendHandshake(Lockstep *ls, uint8_t type) {
+  uint8_t buf[16];
+  int len = 0;
+  Put8(buf, &len, type);
+  Put32(buf, &len, LOCKSTEP_MAGIC);
+  Put16(buf, &len, LOCKSTEP_VERSION);
+  if (type == PACKET_WELCOME)
+    Put32(buf, &len, ls->seed);
+  SendRaw(ls, buf, len);
+}
+
+static void CheckHash(Lockstep *ls, int slot) {
+  if (ls->local_hash_frame[slot] < 0 ||
+      ls->local_hash_frame[slot] != ls->remote_hash_frame[slot])
+    return;
+  ls->hashes_checked++;
+  if (ls->local_hash[slot] != ls->remote_hash[slot] && !ls->desync) {
+    ls->desync = true;
+    ls->desync_frame = ls->local_hash_frame[slot];
+  }
+}
+
+static void UpdateRtt(Lockstep *ls, float sample_ms) {
+  if (!ls->rtt_valid) {
+    ls->srtt_ms = sample_ms;
+    ls->rttvar_ms = sample_ms * 0.5f;
+    ls->rtt_valid = true;
+    return;
+  }
+  float err = sample_ms - ls->srtt_ms;
+  ls->srtt_ms += err * 0.125f;
+  ls->rttvar_ms += ((err < 0.0f ? -err : err) - ls->rttvar_ms) * 0.25f;
+}
+
+// 入力パケットの中身は 1バイト = (連続数 - 1) << 3 | 入力 のランレングス.
+// 入力はほとんどのフレームで前フレームと同じなので, 変化点だけを送る形になる.
+static int EncodeInputs(const Lockstep *ls, int32_t first, int count,
+                        uint8_t *out) {
+  int len = 0;
+  int i = 0;
+  while (i < count) {
+    uint8_t v = ls->local_inputs[(first + i) % LOCKSTEP_RING];
+    int run = 1;
+    while (i + run < count && run < 32 &&
+           ls->local_inputs[(first + i + run) % LOCKSTEP_RING] == v)
+      run++;
+    out[len++] = (uint8_t)((run - 1) << 3 | (v & 0x7));
+    i += run;
+  }
+  return len;
+}
+
+static void ReceiveInputs(Lockstep *ls, const uint8_t *buf, int len,
+                          uint64_t now) {
+  if (len < 36)
+    return;
+  int32_t ack = (int32_t)Get32(buf + 1);
+  int32_t first = (int32_t)Get32(buf + 5);
+  int count = buf[9] | buf[10] << 8;
+  uint32_t echo = Get32(buf + 16);
+  uint32_t hold = Get32(buf + 20);
+  int32_t hash_frame = (int32_t)Get32(buf + 24);
+  uint64_t hash = Get64(buf + 28);
+  const uint8_t *runs = buf + 36;
+  int runs_len = len - 36;
+
+  ls->echo_stamp = Get32(buf + 12);
+  ls->echo_recv_us = now;
+  if (echo != 0) {
+    uint32_t rtt_us = (uint32_t)now - echo - hold;
+    if (rtt_us < 10000000u)
+      UpdateRtt(ls, (float)rtt_us / 1000.0f);
+  }
+  if (ack > ls->remote_acked)
+    ls->remote_acked = ack;
+
+  int32_t frame = first;
+  for (int i = 0; i < runs_len && frame < first + count; i++) {
+    int run = (runs[i] >> 3) + 1;
+    uint8_t v = runs[i] & 0x7;
+    for (int k = 0; k < run; k++, frame++) {
+      if (frame != ls->remote_last + 1)
+        continue;
+      if (frame - ls->sim_frame >= LOCKSTEP_RING)
+        break;
+      ls->remote_inputs[frame % LOCKSTEP_RING] = v;
+      ls->remote_last = frame;
+    }
+  }
+
+  if (hash_frame >= 0) {
+    int slot = (hash_frame / LOCKSTEP_HASH_INTERVAL) % LOCKSTEP_HASH_SLOTS;
+    if (ls->remote_hash_frame[slot] == hash_frame)
+      return;
+    ls->remote_hash_frame[slot] = hash_frame;
+    ls->remote_hash[slot] = hash;
+    CheckHash(ls, slot);
+  }
+}
+
+void LockstepPoll(Lockstep *ls) {
+  if (ls->sock < 0)
+    return;
+  uint64_t now = NowMicros();
+  uint8_t buf[PACKET_MAX];
+  for (;;) {
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t n = recvfrom(ls->sock, buf, sizeof(buf), 0,
+                         (struct sockaddr *)&from, &from_len);
+    if (n <= 0)
+      break;
+    int len = (int)n;
+    uint8_t type = buf[0];
+    if (type == PACKET_HELLO && ls->is_host && len >= 7 &&
+        Get32(buf + 1) == LOCKSTEP_MAGIC &&
+        (buf[5] | buf[6] << 8) == LOCKSTEP_VERSION) {
+      if (ls->status == LOCKSTEP_CONNECTING) {
+        ls->peer = from;
+        ls->status = LOCKSTEP_RUNNING;
+        ls->last_recv_us = now;
+      }
+      // WELCOME が失われた場合は相手が HELLO を再送してくる
+      if (ls->status == LOCKSTEP_RUNNING)
+        SendHandshake(ls, PACKET_WELCOME);
+      continue;
+    }
+    if (ls->status == LOCKSTEP_CONNECTING && !ls->is_host &&
+        type == PACKET_WELCOME && len >= 11 &&
+        Get32(buf + 1) == LOCKSTEP_MAGIC) {
+      ls->seed = Get32(buf + 7);
+      ls->status = LOCKSTEP_RUNNING;
+      ls->last_recv_us = now;
+      continue;
+    }
+    if (ls->status != LOCKSTEP_RUNNING ||
+        from.sin_addr.s_addr != ls->peer.sin_addr.s_addr ||
+        from.sin_port != ls->peer.sin_port)
+      continue;
+    ls->packets_recv++;
+    ls->last_recv_us = now;
+    if (type == PACKET_INPUT) {
+      ReceiveInputs(ls, buf, len, now);
+    } else if (type == PACKET_QUIT) {
+      ls->status = LOCKSTEP_DISCONNECTED;
+    }
+  }
+
+  if (ls->status == LOCKSTEP_CONNECTING && !ls->is_host &&
+      now - ls->last_hello_us >= HELLO_INTERVAL_US) {
+    SendHandshake(ls, PACKET_HELLO);
+    ls->last_hello_us = now;
+  }
+  if (ls->status == LOCKSTEP_RUNNING && now - ls->last_recv_us > TIMEOUT_US) {
+    ls->status = LOCKSTEP_DISCONNECTED;
+  }
+}
+
+// 片道の遅れ + ゆらぎ分を何フレームで吸収できるか.
+// 上げるのはすぐ, 下げるのはゆっくり
+static void AdaptDelay(Lockstep *ls) {
+  if (!ls->rtt_valid)
+    return;
+  float need_ms = ls->srtt_ms * 0.5f + ls->rttvar_ms * 2.0f;
+  int target = 1 + (int)(need_ms / LOCKSTEP_FRAME_MS);
+  if (target < LOCKSTEP_MIN_DELAY)
+    target = LOCKSTEP_MIN_DELAY;
+  if (target > LOCKSTEP_MAX_DELAY)
+    target = LOCKSTEP_MAX_DELAY;
+  if (target > ls->delay) {
+    ls->delay = target;
+    ls->delay_lower_ticks = 0;
+  } else if (target < ls->delay) {
+    if (++ls->delay_lower_ticks >= DELAY_LOWER_TICKS) {
+      ls->delay--;
+      ls->delay_lower_ticks = 0;
+    }
+  } else {
+    ls->delay_lower_ticks = 0;
+  }
+}
+
+// 今サンプリングした入力を sim_frame + delay に割り当てる.
+// 遅延が増えたときは間のフレームを同じ入力で埋め, 減ったときは割り当てを見送る.
+bool LockstepAddLocalInput(Lockstep *ls, uint8_t input) {
+  if (ls->status != LOCKSTEP_RUNNING)
+    return false;
+  AdaptDelay(ls);
+  bool added = false;
+  while (ls->local_last < ls->sim_frame + ls->delay &&
+         ls->local_last - ls->remote_acked < LOCKSTEP_RING - 1) {
+    ls->local_last++;
+    ls->local_inputs[ls->local_last % LOCKSTEP_RING] = input & 0x7;
+    added = true;
+  }
+  return added;
+}
+
+void LockstepSend(Lockstep *ls) {
+  if (ls->status != LOCKSTEP_RUNNING)
+    return;
+  uint64_t now = NowMicros();
+  int32_t first = ls->remote_acked + 1;
+  if (ls->local_last - first + 1 > LOCKSTEP_MAX_SEND)
+    first = ls->local_last - LOCKSTEP_MAX_SEND + 1;
+  int count = ls->local_last - first + 1;
+  if (count < 0)
+    count = 0;
+
+  uint8_t buf[PACKET_MAX];
+  int len = 0;
+  Put8(buf, &len, PACKET_INPUT);
+  Put32(buf, &len, (uint32_t)ls->remote_last);
+  Put32(buf, &len, (uint32_t)first);
+  Put16(buf, &len, (uint16_t)count);
+  Put8(buf, &len, (uint8_t)ls->delay);
+  Put32(buf, &len, (uint32_t)now | 1u);
+  Put32(buf, &len, ls->echo_stamp);
+  Put32(buf, &len, ls->echo_stamp ? (uint32_t)(now - ls->echo_recv_us) : 0u);
+  Put32(buf, &len, (uint32_t)ls->last_hash_frame);
+  Put64(buf, &len, ls->last_hash);
+  int payload = EncodeInputs(ls, first, count, buf + len);
+  len += payload;
+  SendRaw(ls, buf, len);
+  ls->inputs_sent += (uint64_t)count;
+  ls->input_bytes += (uint64_t)payload;
+}
+
+bool LockstepNextFrame(Lockstep *ls, uint8_t *input0, uint8_t *input1) {
+  if (ls->status != LOCKSTEP_RUNNING)
+    return false;
+  if (ls->sim_frame > ls->local_last || ls->sim_frame > ls->remote_last) {
+    ls->stall_ticks++;
+    return false;
+  }
+  uint8_t local = ls->local_inputs[ls->sim_frame % LOCKSTEP_RING];
+  uint8_t remote = ls->remote_inputs[ls->sim_frame % LOCKSTEP_RING];
+  *input0 = ls->player == 0 ? local : remote;
+  *input1 = ls->player == 0 ? remote : local;
+  ls->sim_frame++;
+  ls->delay_sum += (uint64_t)ls->delay;
+  return true;
+}
+
+void LockstepReportHash(Lockstep *ls, int32_t frame, uint64_t hash) {
+  int slot = (frame / LOCKSTEP_HASH_INTERVAL) % LOCKSTEP_HASH_SLOTS;
+  ls->local_hash_frame[slot] = frame;
+  ls->local_hash[slot] = hash;
+  ls->last_hash_frame = frame;
+  ls->last_hash = hash;
+  CheckHash(ls, slot);
+}
+
+float LockstepAddedLatencyMs(const Lockstep *ls) {
+  return (float)ls->delay * LOCKSTEP_FRAME_MS;
+}
+
+float LockstepAvgAddedLatencyMs(const Lockstep *ls) {
+  if (ls->sim_frame <= 0)
+    return LockstepAddedLatencyMs(ls);
+  return (float)ls->delay_sum / (float)ls->sim_frame * LOCKSTEP_FRAME_MS;
+}
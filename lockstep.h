@@ -0,0 +1,90 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LOCKSTEP_VERSION 1
+#define LOCKSTEP_RING 256
+// 1パケットに載せる未確認入力の最大フレーム数 (パケットロス対策の冗長分)
+#define LOCKSTEP_MAX_SEND 128
+#define LOCKSTEP_MIN_DELAY 1
+#define LOCKSTEP_MAX_DELAY 12
+#define LOCKSTEP_HASH_INTERVAL 30
+#define LOCKSTEP_HASH_SLOTS 16
+#define LOCKSTEP_FRAME_MS (1000.0f / 60.0f)
+
+typedef enum {
+  LOCKSTEP_CONNECTING = 0,
+  LOCKSTEP_RUNNING,
+  LOCKSTEP_DISCONNECTED
+} LockstepStatus;
+
+typedef struct {
+  int sock;
+  struct sockaddr_in peer;
+  bool is_host;
+  // 0: ホスト (左側), 1: 参加側 (右側)
+  int player;
+  LockstepStatus status;
+  uint32_t seed;
+
+  uint8_t local_inputs[LOCKSTEP_RING];
+  uint8_t remote_inputs[LOCKSTEP_RING];
+  // 入力が確定している最後のフレーム
+  int32_t local_last;
+  // 相手から途切れずに受信できている最後のフレーム
+  int32_t remote_last;
+  // 相手が受信済みと返してきた自分の入力の最後のフレーム
+  int32_t remote_acked;
+  // 次にシミュレーションするフレーム
+  int32_t sim_frame;
+
+  // 入力遅延 (フレーム). RTT から決める
+  int delay;
+  int delay_lower_ticks;
+  float srtt_ms;
+  float rttvar_ms;
+  bool rtt_valid;
+  uint32_t echo_stamp;
+  uint64_t echo_recv_us;
+
+  uint64_t last_recv_us;
+  uint64_t last_hello_us;
+
+  int32_t local_hash_frame[LOCKSTEP_HASH_SLOTS];
+  uint64_t local_hash[LOCKSTEP_HASH_SLOTS];
+  int32_t remote_hash_frame[LOCKSTEP_HASH_SLOTS];
+  uint64_t remote_hash[LOCKSTEP_HASH_SLOTS];
+  int32_t last_hash_frame;
+  uint64_t last_hash;
+  int32_t hashes_checked;
+  bool desync;
+  int32_t desync_frame;
+
+  uint64_t packets_sent;
+  uint64_t packets_recv;
+  uint64_t bytes_sent;
+  // 冗長分も含めて送った入力フレーム数と, その圧縮後のバイト数
+  uint64_t inputs_sent;
+  uint64_t input_bytes;
+  uint64_t stall_ticks;
+  uint64_t delay_sum;
+} Lockstep;
+
+bool LockstepHost(Lockstep *ls, uint16_t port, uint32_t seed);
+bool LockstepJoin(Lockstep *ls, const char *host, uint16_t port);
+void LockstepClose(Lockstep *ls);
+
+void LockstepPoll(Lockstep *ls);
+bool LockstepAddLocalInput(Lockstep *ls, uint8_t input);
+void LockstepSend(Lockstep *ls);
+bool LockstepNextFrame(Lockstep *ls, uint8_t *input0, uint8_t *input1);
+void LockstepReportHash(Lockstep *ls, int32_t frame, uint64_t hash);
+
+// 入力遅延によって上乗せされる遅れ (ミリ秒). avg は開始からの平均
+float LockstepAddedLatencyMs(const Lockstep *ls);
+float LockstepAvgAddedLatencyMs(const Lockstep *ls);
+
+#endif
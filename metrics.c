@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// 書き手が書き込み中のまま止まっていたら, いったん諦めて BUSY を返す
+#define METRICS_MAX_RETRIES 1000
+
+// name を新しく作って対応付ける. すでにあれば errno = EEXIST で NULL
+static MetricsBlock *CreateBlock(const char *name) {
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0)
+    return NULL;
+  if (ftruncate(fd, sizeof(MetricsBlock)) != 0) {
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+  void *p = mmap(NULL, sizeof(MetricsBlock), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    shm_unlink(name);
+    return NULL;
+  }
+  return p;
+}
+
+// name のブロックを書いたプロセスがまだ生きているか. 作りかけで pid が
+// まだ読めないものも使用中とみなす. pid が別のプロセスに再利用されていれば
+// 生きていると判断するが, そのときは別の名前に書くだけなので害はない
+static bool OwnerAlive(const char *name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  bool alive = true;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(MetricsBlock)) {
+    void *p = mmap(NULL, sizeof(MetricsBlock), PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+      uint32_t pid = ((const MetricsBlock *)p)->pid;
+      // EPERM は別のユーザーのプロセスが生きている
+      if (pid != 0)
+        alive = kill((pid_t)pid, 0) == 0 || errno == EPERM;
+      munmap(p, sizeof(MetricsBlock));
+    }
+  }
+  close(fd);
+  return alive;
+}
+
+bool MetricsOpen(MetricsPublisher *m, const char *name) {
+  memset(m, 0, sizeof(*m));
+  char own[sizeof(m->name)];
+  int len = snprintf(own, sizeof(own), "%s_%d", name, (int)getpid());
+  if (len < 0 || (size_t)len >= sizeof(own))
+    return false;
+
+  // 他の書き手のブロックを消したり書き換えたりしないよう, 必ず新しく作る.
+  // 落ちた書き手が残したものだけは消して作り直し, 生きている書き手が
+  // いれば pid を付けた名前に書く
+  const char *used = name;
+  MetricsBlock *block = CreateBlock(name);
+  bool taken = block == NULL && errno == EEXIST;
+  if (taken && !OwnerAlive(name)) {
+    shm_unlink(name);
+    block = CreateBlock(name);
+    taken = block == NULL && errno == EEXIST;
+  }
+  if (taken) {
+    used = own;
+    block = CreateBlock(own);
+  }
+  if (block == NULL)
+    return false;
+
+  // ftruncate で 0 埋めされている. magic は最後に書いて, 読み手が
+  // 作りかけのブロックを読まないようにする
+  block->version = METRICS_VERSION;
+  block->size = sizeof(MetricsBlock);
+  block->pid = (uint32_t)getpid();
+  atomic_store_explicit(&block->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  block->magic = METRICS_MAGIC;
+  m->block = block;
+  strcpy(m->name, used);
+  return true;
+}
+
+void MetricsClose(MetricsPublisher *m) {
+  if (m->block == NULL)
+    return;
+  munmap(m->block, sizeof(MetricsBlock));
+  shm_unlink(m->name);
+  m->block = NULL;
+}
+
+// sorted_ms の中で value 以上の最初の位置
+static int LowerBound(const float *sorted, int n, float value) {
+  int lo = 0;
+  int hi = n;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (sorted[mid] < value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// 並べ替えた窓を1件ずつ差し替えて保つ. 毎回並べ直すより十分安く,
+// 百分位はそのまま添字で引ける
+static void AddFrameTime(MetricsPublisher *m, float frame_ms) {
+  float *sorted = m->sorted_ms;
+  if (m->count == METRICS_SAMPLES) {
+    float old = m->frame_ms[m->head];
+    int at = LowerBound(sorted, m->count, old);
+    memmove(sorted + at, sorted + at + 1,
+            sizeof(float) * (size_t)(m->count - at - 1));
+    m->count--;
+    m->sum_ms -= old;
+  }
+  int at = LowerBound(sorted, m->count, frame_ms);
+  memmove(sorted + at + 1, sorted + at,
+          sizeof(float) * (size_t)(m->count - at));
+  sorted[at] = frame_ms;
+  m->count++;
+  m->sum_ms += frame_ms;
+  m->frame_ms[m->head] = frame_ms;
+  m->head = (m->head + 1) % METRICS_SAMPLES;
+}
+
+void MetricsPublish(MetricsPublisher *m, MetricsSample *sample,
+                    float frame_ms) {
+  if (m->block == NULL)
+    return;
+  AddFrameTime(m, frame_ms);
+  const float *sorted = m->sorted_ms;
+  int n = m->count;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  sample->frame = ++m->frame;
+  sample->time_sec = (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+  sample->fps = m->sum_ms > 0.0 ? (float)(n * 1000.0 / m->sum_ms) : 0.0f;
+  sample->frame_ms_p50 = sorted[n * 50 / 100];
+  sample->frame_ms_p95 = sorted[n * 95 / 100];
+  sample->frame_ms_p99 = sorted[n * 99 / 100];
+  sample->frame_ms_max = sorted[n - 1];
+
+  // 書き手は1人なので seq は普通に読んでよい
+  MetricsBlock *block = m->block;
+  uint32_t seq = atomic_load_explicit(&block->seq, memory_order_relaxed);
+  atomic_store_explicit(&block->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  block->sample = *sample;
+  atomic_store_explicit(&block->seq, seq + 2, memory_order_release);
+}
+
+const MetricsBlock *MetricsAttach(const char *name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+  void *p = mmap(NULL, sizeof(MetricsBlock), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  return p == MAP_FAILED ? NULL : p;
+}
+
+void MetricsDetach(const MetricsBlock *block) {
+  if (block != NULL)
+    munmap((void *)block, sizeof(MetricsBlock));
+}
+
+int MetricsRead(const MetricsBlock *block, MetricsSample *out) {
+  if (block->magic != METRICS_MAGIC || block->version != METRICS_VERSION)
+    return METRICS_READ_BAD;
+  atomic_thread_fence(memory_order_acquire);
+  // 古い書き手 (項目が少ない) なら知っている分だけ写し, 残りは 0
+  size_t avail = block->size > offsetof(MetricsBlock, sample)
+                     ? block->size - offsetof(MetricsBlock, sample)
+                     : 0;
+  size_t len = avail < sizeof(*out) ? avail : sizeof(*out);
+  memset(out, 0, sizeof(*out));
+  for (int tries = 0; tries < METRICS_MAX_RETRIES; tries++) {
+    uint32_t before = atomic_load_explicit(&block->seq, memory_order_acquire);
+    if (before & 1) {
+      // 1コアでは書き手が途中で止められていることがあるので, 回り続けずに譲る
+      sched_yield();
+      continue;
+    }
+    memcpy(out, &block->sample, len);
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t after = atomic_load_explicit(&block->seq, memory_order_relaxed);
+    if (before == after)
+      return tries;
+  }
+  return METRICS_READ_BUSY;
+}
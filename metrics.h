@@ -0,0 +1,87 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// 外部のダッシュボード向けに, 毎フレームの統計を POSIX 共有メモリへ書き出す.
+// 書き込みはシーケンスロック (seq が奇数の間は書き込み中) なので, ゲーム側は
+// 読み手を待たずメモリに書くだけで済む. 読み手は seq が前後で同じ偶数に
+// なるまで読み直す. 画面や音声には依存しない.
+
+#define METRICS_DEFAULT_NAME "/pong_metrics"
+#define METRICS_MAGIC 0x4d474e50u
+// 既存の項目の意味や位置を変えたら上げる. 末尾への追加は size で判別する
+#define METRICS_VERSION 1
+// フレーム時間の百分位を求める標本数
+#define METRICS_SAMPLES 256
+
+// MetricsRead の失敗. BUSY は書き手が書き込み中のまま止まっている
+// (読み直せばよい), BAD は magic か版が違う (読めない)
+#define METRICS_READ_BAD (-1)
+#define METRICS_READ_BUSY (-2)
+
+// 1フレーム分の値 (ゲーム側が埋める部分と, MetricsPublish が埋める部分)
+typedef struct {
+  uint64_t frame;
+  // CLOCK_MONOTONIC の秒
+  double time_sec;
+  // 直近 METRICS_SAMPLES フレームから求めた値
+  float fps;
+  float frame_ms_p50;
+  float frame_ms_p95;
+  float frame_ms_p99;
+  float frame_ms_max;
+  // main.c の GameState
+  int32_t state;
+  int32_t level;
+  int32_t score;
+  int32_t lives;
+  int32_t balls;
+  int32_t particles;
+  int32_t powerups;
+  // BGM の更新が MUSIC_GAP_SEC (main.c) より空いた回数. 音切れの目安
+  uint32_t music_update_gaps;
+} MetricsSample;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  // sizeof(MetricsBlock). 読み手は自分の知っている長さまでを読む
+  uint32_t size;
+  uint32_t pid;
+  _Atomic uint32_t seq;
+  uint32_t reserved;
+  MetricsSample sample;
+} MetricsBlock;
+
+typedef struct {
+  MetricsBlock *block;
+  char name[64];
+  // 直近のフレーム時間 (到着順の輪と, 常に昇順に保つ写し)
+  float frame_ms[METRICS_SAMPLES];
+  float sorted_ms[METRICS_SAMPLES];
+  int count;
+  int head;
+  double sum_ms;
+  uint64_t frame;
+} MetricsPublisher;
+
+// 共有メモリを作って対応付ける. 失敗したら false (publisher は無効のまま).
+// name を生きている別の書き手が使っていれば "name_<pid>" に書く
+// (実際の名前は m->name).
+bool MetricsOpen(MetricsPublisher *m, const char *name);
+void MetricsClose(MetricsPublisher *m);
+// frame_ms を統計に加え, sample の残りの項目を埋めて書き出す.
+// 無効な publisher なら何もしない.
+void MetricsPublish(MetricsPublisher *m, MetricsSample *sample, float frame_ms);
+
+// 読み手用. 対応付けたブロックを返す (失敗したら NULL).
+const MetricsBlock *MetricsAttach(const char *name);
+void MetricsDetach(const MetricsBlock *block);
+// 一貫した1フレーム分を out へ写す. 読み直した回数を返す
+// (読めなければ METRICS_READ_BAD か METRICS_READ_BUSY).
+int MetricsRead(const MetricsBlock *block, MetricsSample *out);
+
+#endif
@@ -0,0 +1,118 @@
+#include "pacing.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// 見積もりより少し早めに起きる分 (秒). スリープの精度のばらつきを吸収する
+#define PACER_MARGIN 0.0015
+#define PACER_STATS_INTERVAL 30
+
+void PacerInit(FramePacer *pacer, bool low_latency, bool vsync, int target_hz) {
+  memset(pacer, 0, sizeof(*pacer));
+  pacer->vsync = vsync;
+  pacer->target_hz = target_hz;
+  pacer->work_est = 0.004;
+  pacer->sample_time = GetTime();
+  pacer->prev_sample_time = pacer->sample_time;
+  pacer->last_present = pacer->sample_time;
+  PacerSetLowLatency(pacer, low_latency);
+}
+
+void PacerSetLowLatency(FramePacer *pacer, bool on) {
+  pacer->low_latency = on;
+  // 低遅延モードでは待ちを自前で行うので raylib 側の上限は外す
+  SetTargetFPS(on ? 0 : pacer->target_hz);
+}
+
+static int CompareFloat(const void *a, const void *b) {
+  float fa = *(const float *)a;
+  float fb = *(const float *)b;
+  return (fa > fb) - (fa < fb);
+}
+
+static void UpdatePercentiles(FramePacer *pacer) {
+  float sorted[PACER_SAMPLES];
+  int n = pacer->latency_count;
+  if (n == 0)
+    return;
+  memcpy(sorted, pacer->latency_ms, sizeof(float) * (size_t)n);
+  qsort(sorted, (size_t)n, sizeof(float), CompareFloat);
+  pacer->p50 = sorted[n * 50 / 100];
+  pacer->p95 = sorted[n * 95 / 100];
+  pacer->p99 = sorted[n * 99 / 100];
+}
+
+void PacerBeginFrame(FramePacer *pacer) {
+  pacer->prev_sample_time = pacer->sample_time;
+  memset(pacer->key_latch, 0, sizeof(pacer->key_latch));
+  pacer->mouse_latch = false;
+  if (!pacer->low_latency) {
+    // 入力は直前の EndDrawing の最後に読まれている
+    pacer->sample_time = pacer->last_present;
+    return;
+  }
+
+  if (pacer->target_hz > 0) {
+    double wake = pacer->last_present + 1.0 / pacer->target_hz -
+                  pacer->work_est - PACER_MARGIN;
+    double now = GetTime();
+    if (wake > now)
+      WaitTime(wake - now);
+  }
+
+  // ここで読み直すと前回のポーリングで立った「押された」は消えるので
+  // 先に控えておく
+  for (int key = GetKeyPressed(); key != 0; key = GetKeyPressed()) {
+    if (key > 0 && key < PACER_MAX_KEYS)
+      pacer->key_latch[key] = true;
+  }
+  pacer->mouse_latch = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+  PollInputEvents();
+  pacer->sample_time = GetTime();
+}
+
+bool PacerKeyPressed(const FramePacer *pacer, int key) {
+  if (IsKeyPressed(key))
+    return true;
+  return key > 0 && key < PACER_MAX_KEYS && pacer->key_latch[key];
+}
+
+bool PacerMousePressed(const FramePacer *pacer) {
+  return IsMouseButtonPressed(MOUSE_LEFT_BUTTON) || pacer->mouse_latch;
+}
+
+void PacerBeforePresent(FramePacer *pacer) {
+  pacer->before_present = GetTime();
+}
+
+void PacerAfterPresent(FramePacer *pacer) {
+  double now = GetTime();
+  double work = pacer->before_present - pacer->sample_time;
+  // 見積もりは上がるときは速く, 下がるときはゆっくり追従させる
+  if (work > pacer->work_est)
+    pacer->work_est += (work - pacer->work_est) * 0.5;
+  else
+    pacer->work_est += (work - pacer->work_est) * 0.05;
+
+  // 表示時刻: 垂直同期ありなら画面の入れ替えが終わった時点.
+  // 通常モードで垂直同期なしの場合, EndDrawing は入れ替え後に raylib の待ちを
+  // 含むので, 入れ替えを出した時点 (EndDrawing の直前) を表示時刻とみなす.
+  double present = now;
+  if (!pacer->low_latency && !pacer->vsync)
+    present = pacer->before_present;
+
+  // 入力の変化は前回と今回の読み取りの間に均等に起きると考え, 平均して
+  // その半分だけ読み取りまでに待たされている
+  double age = (pacer->sample_time - pacer->prev_sample_time) * 0.5;
+  float latency = (float)((present - pacer->sample_time + age) * 1000.0);
+  pacer->latency_ms[pacer->latency_head] = latency;
+  pacer->latency_head = (pacer->latency_head + 1) % PACER_SAMPLES;
+  if (pacer->latency_count < PACER_SAMPLES)
+    pacer->latency_count++;
+  if (++pacer->frames_since_stats >= PACER_STATS_INTERVAL) {
+    pacer->frames_since_stats = 0;
+    UpdatePercentiles(pacer);
+  }
+
+  pacer->last_present = now;
+}
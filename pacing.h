@@ -0,0 +1,43 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include "raylib.h"
+
+#define PACER_SAMPLES 256
+#define PACER_MAX_KEYS 512
+
+// 低遅延モードでは SetTargetFPS による待ちを使わず, 次の表示時刻から
+// 描画にかかる時間を引いた直前まで眠ってから入力を読み直す.
+// 通常モードは従来どおり SetTargetFPS に任せ, 同じ方法で遅延を計測だけする.
+typedef struct {
+  bool low_latency;
+  bool vsync;
+  // 0 なら上限なし
+  int target_hz;
+  // 入力を読んでから表示に出すまでの CPU 時間の見積もり (秒)
+  double work_est;
+  double sample_time;
+  double prev_sample_time;
+  double before_present;
+  double last_present;
+  // 遅く読み直す前のポーリングで押されたキー (取りこぼさないように残す)
+  bool key_latch[PACER_MAX_KEYS];
+  bool mouse_latch;
+  float latency_ms[PACER_SAMPLES];
+  int latency_count;
+  int latency_head;
+  int frames_since_stats;
+  float p50;
+  float p95;
+  float p99;
+} FramePacer;
+
+void PacerInit(FramePacer *pacer, bool low_latency, bool vsync, int target_hz);
+void PacerSetLowLatency(FramePacer *pacer, bool on);
+void PacerBeginFrame(FramePacer *pacer);
+bool PacerKeyPressed(const FramePacer *pacer, int key);
+bool PacerMousePressed(const FramePacer *pacer);
+void PacerBeforePresent(FramePacer *pacer);
+void PacerAfterPresent(FramePacer *pacer);
+
+#endif
@@ -0,0 +1,324 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pongenv.h"
+#include "raster.h"
+#include "world.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PONGENV_DT (1.0f / 60.0f)
+#define PONGENV_MAX_THREADS 256
+
+_Static_assert(PONGENV_OBS_POWERUPS_AT - PONGENV_OBS_BALLS_AT ==
+                   MAX_BALLS * PONGENV_OBS_BALL,
+               "ball count in pongenv.h");
+_Static_assert(PONGENV_OBS_BRICKS_AT - PONGENV_OBS_POWERUPS_AT ==
+                   MAX_POWERUPS * PONGENV_OBS_POWERUP,
+               "power-up count in pongenv.h");
+_Static_assert(PONGENV_OBS_SIZE - PONGENV_OBS_BRICKS_AT ==
+                   MAX_BRICKS * PONGENV_OBS_BRICK,
+               "brick count in pongenv.h");
+
+typedef enum { JOB_RESET = 0, JOB_STEP, JOB_RENDER } JobType;
+
+typedef struct {
+  PongEnv *env;
+  int index;
+} WorkerArg;
+
+typedef struct {
+  World world;
+  int prev_score;
+  int steps;
+  uint32_t episode;
+} EnvSlot;
+
+struct PongEnv {
+  int num_envs;
+  int level;
+  int max_steps;
+  uint32_t seed;
+  EnvSlot *slots;
+
+  // 現在の仕事 (呼び出し中だけ有効なポインタ)
+  JobType job;
+  const uint8_t *actions;
+  float *obs;
+  float *rewards;
+  uint8_t *dones;
+  uint8_t *pixels;
+  // 直前の PongEnvRender の形式. 変わったときだけ背景を作り直す
+  Raster raster;
+
+  // ワーカーは generation が進むのを待ち, 自分の担当範囲を処理する.
+  // 呼び出し側のスレッドも範囲 0 を受け持つ.
+  int num_threads;
+  pthread_t threads[PONGENV_MAX_THREADS];
+  WorkerArg args[PONGENV_MAX_THREADS];
+  pthread_mutex_t lock;
+  pthread_cond_t start_cv;
+  pthread_cond_t done_cv;
+  unsigned generation;
+  int pending;
+  bool quit;
+};
+
+// 環境番号とエピソード番号からシードを作る (splitmix32 風)
+static uint32_t EpisodeSeed(uint32_t seed, int index, uint32_t episode) {
+  uint32_t x = seed ^ ((uint32_t)index * 0x9e3779b9u) ^
+               (episode * 0x85ebca6bu);
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x != 0 ? x : 1u;
+}
+
+static float NormX(Real x) {
+  return (RealToFloat(x) - PLAY_X) * (1.0f / PLAY_W);
+}
+static float NormY(Real y) {
+  return (RealToFloat(y) - PLAY_Y) * (1.0f / PLAY_H);
+}
+
+static void WriteObs(const World *world, float *out) {
+  out[0] = NormX(world->paddle.x + RealMul(world->paddle.width, REAL(0.5f)));
+  out[1] = RealToFloat(world->paddle.width) / PLAY_W;
+  out[2] = (float)world->lives;
+  out[3] = (float)world->combo;
+  out[4] = (float)world->speed_state;
+  out[5] = (float)world->breakable_left / MAX_BRICKS;
+
+  float *o = out + PONGENV_OBS_BALLS_AT;
+  for (int i = 0; i < MAX_BALLS; i++, o += PONGENV_OBS_BALL) {
+    const Ball *b = &world->balls[i];
+    if (!b->active) {
+      memset(o, 0, sizeof(float) * PONGENV_OBS_BALL);
+      continue;
+    }
+    o[0] = 1.0f;
+    o[1] = b->stuck ? 1.0f : 0.0f;
+    o[2] = NormX(b->pos.x);
+    o[3] = NormY(b->pos.y);
+    o[4] = RealToFloat(b->vel.x);
+    o[5] = RealToFloat(b->vel.y);
+  }
+
+  o = out + PONGENV_OBS_POWERUPS_AT;
+  for (int i = 0; i < MAX_POWERUPS; i++, o += PONGENV_OBS_POWERUP) {
+    const Powerup *p = &world->powerups[i];
+    if (!p->active) {
+      memset(o, 0, sizeof(float) * PONGENV_OBS_POWERUP);
+      continue;
+    }
+    o[0] = 1.0f;
+    o[1] = NormX(p->pos.x);
+    o[2] = NormY(p->pos.y);
+    o[3] = (float)p->type / (float)POWER_DEATH;
+  }
+
+  o = out + PONGENV_OBS_BRICKS_AT;
+  for (int i = 0; i < MAX_BRICKS; i++, o += PONGENV_OBS_BRICK) {
+    const Brick *b = &world->bricks[i];
+    o[0] = !b->alive ? 0.0f : (b->solid ? 0.5f : 1.0f);
+    o[1] = NormX(b->rect.x + RealMul(b->rect.width, REAL(0.5f)));
+    o[2] = NormY(b->rect.y + RealMul(b->rect.height, REAL(0.5f)));
+  }
+}
+
+static void ResetSlot(PongEnv *env, int index) {
+  EnvSlot *slot = &env->slots[index];
+  WorldInit(&slot->world, env->level,
+            EpisodeSeed(env->seed, index, slot->episode));
+  slot->world.no_fx = true;
+  slot->episode++;
+  slot->prev_score = 0;
+  slot->steps = 0;
+}
+
+static void RunRange(PongEnv *env, int begin, int end) {
+  for (int i = begin; i < end; i++) {
+    EnvSlot *slot = &env->slots[i];
+    if (env->job == JOB_RENDER) {
+      size_t frame = (size_t)env->raster.width * env->raster.height *
+                     env->raster.channels;
+      RasterDraw(&env->raster, &slot->world, env->pixels + (size_t)i * frame);
+      continue;
+    }
+    float *obs = env->obs + (size_t)i * PONGENV_OBS_SIZE;
+    if (env->job == JOB_RESET) {
+      slot->episode = 0;
+      ResetSlot(env, i);
+      WriteObs(&slot->world, obs);
+      continue;
+    }
+
+    WorldStep(&slot->world, env->actions[i] & INPUT_MASK, PONGENV_DT);
+    slot->steps++;
+    env->rewards[i] = (float)(slot->world.score - slot->prev_score);
+    slot->prev_score = slot->world.score;
+    uint8_t done = PONGENV_DONE_NONE;
+    if (slot->world.status != WORLD_PLAY)
+      done = PONGENV_DONE_TERMINAL;
+    else if (env->max_steps > 0 && slot->steps >= env->max_steps)
+      done = PONGENV_DONE_TRUNCATED;
+    env->dones[i] = done;
+    if (done != PONGENV_DONE_NONE)
+      ResetSlot(env, i);
+    WriteObs(&slot->world, obs);
+  }
+}
+
+static void RunShare(PongEnv *env, int index) {
+  // 連続した範囲に分けてキャッシュを共有しないようにする
+  int per = env->num_envs / env->num_threads;
+  int extra = env->num_envs % env->num_threads;
+  int begin = index * per + (index < extra ? index : extra);
+  int end = begin + per + (index < extra ? 1 : 0);
+  RunRange(env, begin, end);
+}
+
+static void *WorkerMain(void *arg) {
+  WorkerArg *wa = arg;
+  PongEnv *env = wa->env;
+  unsigned seen = 0;
+  for (;;) {
+    pthread_mutex_lock(&env->lock);
+    while (env->generation == seen && !env->quit)
+      pthread_cond_wait(&env->start_cv, &env->lock);
+    if (env->quit) {
+      pthread_mutex_unlock(&env->lock);
+      return NULL;
+    }
+    seen = env->generation;
+    pthread_mutex_unlock(&env->lock);
+
+    RunShare(env, wa->index);
+
+    pthread_mutex_lock(&env->lock);
+    if (--env->pending == 0)
+      pthread_cond_signal(&env->done_cv);
+    pthread_mutex_unlock(&env->lock);
+  }
+}
+
+static void RunJob(PongEnv *env) {
+  if (env->num_threads == 1) {
+    RunShare(env, 0);
+    return;
+  }
+  pthread_mutex_lock(&env->lock);
+  env->pending = env->num_threads - 1;
+  env->generation++;
+  pthread_cond_broadcast(&env->start_cv);
+  pthread_mutex_unlock(&env->lock);
+
+  RunShare(env, 0);
+
+  pthread_mutex_lock(&env->lock);
+  while (env->pending > 0)
+    pthread_cond_wait(&env->done_cv, &env->lock);
+  pthread_mutex_unlock(&env->lock);
+}
+
+PongEnv *PongEnvCreate(int num_envs, int level, int num_threads,
+                       int max_steps) {
+  if (num_envs <= 0 || level < 1 || level > LEVEL_MOVING)
+    return NULL;
+  if (num_threads <= 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cores > 0 ? (int)cores : 1;
+  }
+  if (num_threads > num_envs)
+    num_threads = num_envs;
+  if (num_threads > PONGENV_MAX_THREADS)
+    num_threads = PONGENV_MAX_THREADS;
+
+  PongEnv *env = calloc(1, sizeof(*env));
+  if (env == NULL)
+    return NULL;
+  env->slots = calloc((size_t)num_envs, sizeof(EnvSlot));
+  if (env->slots == NULL) {
+    free(env);
+    return NULL;
+  }
+  env->num_envs = num_envs;
+  env->level = level;
+  env->max_steps = max_steps;
+  env->num_threads = 1;
+  pthread_mutex_init(&env->lock, NULL);
+  pthread_cond_init(&env->start_cv, NULL);
+  pthread_cond_init(&env->done_cv, NULL);
+
+  // スレッドが作れなかった分は残りのスレッドで受け持つ
+  for (int i = 1; i < num_threads; i++) {
+    env->args[i] = (WorkerArg){env, i};
+    if (pthread_create(&env->threads[i], NULL, WorkerMain, &env->args[i]))
+      break;
+    env->num_threads++;
+  }
+
+  // Reset より前に Step されても演出は作らない
+  for (int i = 0; i < num_envs; i++) {
+    WorldInit(&env->slots[i].world, level, EpisodeSeed(0, i, 0));
+    env->slots[i].world.no_fx = true;
+  }
+  return env;
+}
+
+void PongEnvDestroy(PongEnv *env) {
+  if (env == NULL)
+    return;
+  pthread_mutex_lock(&env->lock);
+  env->quit = true;
+  pthread_cond_broadcast(&env->start_cv);
+  pthread_mutex_unlock(&env->lock);
+  for (int i = 1; i < env->num_threads; i++)
+    pthread_join(env->threads[i], NULL);
+  pthread_cond_destroy(&env->done_cv);
+  pthread_cond_destroy(&env->start_cv);
+  pthread_mutex_destroy(&env->lock);
+  RasterFree(&env->raster);
+  free(env->slots);
+  free(env);
+}
+
+int PongEnvNumEnvs(const PongEnv *env) { return env->num_envs; }
+
+int PongEnvObsSize(void) { return PONGENV_OBS_SIZE; }
+
+void PongEnvReset(PongEnv *env, uint32_t seed, float *obs) {
+  env->seed = seed;
+  env->job = JOB_RESET;
+  env->obs = obs;
+  RunJob(env);
+}
+
+void PongEnvStep(PongEnv *env, const uint8_t *actions, float *obs,
+                 float *rewards, uint8_t *dones) {
+  env->job = JOB_STEP;
+  env->actions = actions;
+  env->obs = obs;
+  env->rewards = rewards;
+  env->dones = dones;
+  RunJob(env);
+}
+
+int PongEnvRender(PongEnv *env, uint8_t *pixels, int width, int height,
+                  int channels) {
+  Raster *raster = &env->raster;
+  if (raster->background == NULL || raster->width != width ||
+      raster->height != height || raster->channels != channels) {
+    RasterFree(raster);
+    if (!RasterInit(raster, width, height, channels))
+      return -1;
+  }
+  env->job = JOB_RENDER;
+  env->pixels = pixels;
+  RunJob(env);
+  return 0;
+}
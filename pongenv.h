@@ -0,0 +1,74 @@
+#ifndef PONGENV_H
+#define PONGENV_H
+
+#include <stdint.h>
+
+// 強化学習用の環境 (libpongenv.so). 窓も GPU も使わず, N 個の独立した
+// World をまとめて進める. 観測・報酬・終了フラグは呼び出し側が用意した
+// 連続したバッファへ直接書き込む (ライブラリ内でのコピーはしない).
+//
+//   obs:     float [num_envs * PONGENV_OBS_SIZE]
+//   rewards: float [num_envs]   そのステップで増えたスコア (100 + combo * 30 等)
+//   dones:   uint8 [num_envs]   PONGENV_DONE_*
+//   actions: uint8 [num_envs]   INPUT_LEFT | INPUT_RIGHT | INPUT_LAUNCH
+//
+// 終わった環境はそのステップ内で新しいエピソードに作り直され, obs には
+// 新しいエピソードの最初の観測が入る (報酬と dones は終わった側の値).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define PONGENV_API __attribute__((visibility("default")))
+#else
+#define PONGENV_API
+#endif
+
+#define PONGENV_VERSION 1
+
+// 観測の並び (座標はプレイフィールドを 0-1 に正規化)
+//   [0]  パドル中心 x   [1] パドル幅   [2] ライフ   [3] コンボ
+//   [4]  速度状態 (-1/0/1)   [5] 残りブロック数 / 全スロット数
+//   ボール 4 個 x {有効, 発射前, x, y, vx, vy}
+//   アイテム 6 個 x {有効, x, y, 種類 / 5}
+//   ブロック 96 個 x {状態 (0: 無し, 1: 壊せる, 0.5: 壊せない), 中心 x, 中心 y}
+#define PONGENV_OBS_HEADER 6
+#define PONGENV_OBS_BALL 6
+#define PONGENV_OBS_POWERUP 4
+#define PONGENV_OBS_BRICK 3
+#define PONGENV_OBS_BALLS_AT PONGENV_OBS_HEADER
+#define PONGENV_OBS_POWERUPS_AT (PONGENV_OBS_BALLS_AT + 4 * PONGENV_OBS_BALL)
+#define PONGENV_OBS_BRICKS_AT                                                  \
+  (PONGENV_OBS_POWERUPS_AT + 6 * PONGENV_OBS_POWERUP)
+#define PONGENV_OBS_SIZE (PONGENV_OBS_BRICKS_AT + 96 * PONGENV_OBS_BRICK)
+
+#define PONGENV_DONE_NONE 0
+// クリアかゲームオーバー
+#define PONGENV_DONE_TERMINAL 1
+// max_steps に達して打ち切り
+#define PONGENV_DONE_TRUNCATED 2
+
+typedef struct PongEnv PongEnv;
+
+// level: 1-4, num_threads: 0 ならコア数, max_steps: 0 なら打ち切りなし.
+// 失敗時は NULL.
+PONGENV_API PongEnv *PongEnvCreate(int num_envs, int level, int num_threads,
+                                   int max_steps);
+PONGENV_API void PongEnvDestroy(PongEnv *env);
+PONGENV_API int PongEnvNumEnvs(const PongEnv *env);
+PONGENV_API int PongEnvObsSize(void);
+PONGENV_API void PongEnvReset(PongEnv *env, uint32_t seed, float *obs);
+PONGENV_API void PongEnvStep(PongEnv *env, const uint8_t *actions, float *obs,
+                             float *rewards, uint8_t *dones);
+// 全環境の現在の画面を pixels (num_envs 枚を詰めて並べる) へ描く.
+// channels は 1 (グレー) か 3 (RGB). 84x84 や 160x128 を想定 (最大 1024).
+// 形式が不正なら -1.
+PONGENV_API int PongEnvRender(PongEnv *env, uint8_t *pixels, int width,
+                              int height, int channels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,376 @@
+#include "raster.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 円は 1 ピクセルを 4x4 に分けて内外を数える
+#define SUBSAMPLES 4
+// 半径 r の角を丸めると r x r の正方形から r^2 x CORNER_CUT が欠ける
+#define CORNER_CUT (1.0f - 0.25f * PI)
+
+// 出力形式での色 (グレーなら v[0] だけを使う)
+typedef struct {
+  float v[3];
+} Pixel;
+
+static Pixel ToPixel(const Raster *raster, Rgba c) {
+  Pixel p = {{(float)c.r, (float)c.g, (float)c.b}};
+  if (raster->channels == RASTER_GRAY)
+    p.v[0] = 0.299f * c.r + 0.587f * c.g + 0.114f * c.b;
+  return p;
+}
+
+static Pixel Mix(Pixel a, Pixel b, float t) {
+  Pixel p;
+  for (int c = 0; c < 3; c++)
+    p.v[c] = a.v[c] + (b.v[c] - a.v[c]) * t;
+  return p;
+}
+
+// 区間 [a0, a1) がピクセル [b, b + 1) を覆う長さ
+static float Overlap(float a0, float a1, int b) {
+  float lo = a0 > (float)b ? a0 : (float)b;
+  float hi = a1 < (float)(b + 1) ? a1 : (float)(b + 1);
+  return hi > lo ? hi - lo : 0.0f;
+}
+
+static int FloorClamp(float v, int max) {
+  int i = (int)floorf(v);
+  return i < 0 ? 0 : (i > max ? max : i);
+}
+
+static int CeilClamp(float v, int max) {
+  int i = (int)ceilf(v);
+  return i < 0 ? 0 : (i > max ? max : i);
+}
+
+// ch を定数で呼ぶとインライン展開された先で成分のループが展開され,
+// 内側のループを SIMD 命令にしやすくなる.
+// 外周の覆う割合から角で欠ける割合 cut を除いた部分を fill で塗り,
+// 外周と内側の差 (枠) に edge を edge_alpha で重ねる. 欠ける部分は枠に
+// 含まれるとして, 背景に枠だけが重なった分も数える
+static inline void BoxRow(uint8_t *restrict px, int n, int ch,
+                          const float *restrict cov_outer,
+                          const float *restrict cov_inner,
+                          const float *restrict cut, float cy_outer,
+                          float cy_inner, float edge_alpha, const float *fill,
+                          const float *edge) {
+  for (int x = 0; x < n; x++) {
+    float outer = cov_outer[x] * cy_outer;
+    float rim = (outer - cov_inner[x] * cy_inner) * edge_alpha;
+    float bare = cut[x] * (1.0f - edge_alpha);
+    float keep = 1.0f - outer + bare;
+    float paint = outer - rim - bare;
+    for (int c = 0; c < ch; c++) {
+      float v = px[x * ch + c] * keep + fill[c] * paint + edge[c] * rim;
+      px[x * ch + c] = (uint8_t)(v + 0.5f);
+    }
+  }
+}
+
+// 半径 r の円の 0 <= v <= sqrt(r^2 - u^2) の部分を u について 0 から t
+// (0 <= t <= r) まで積分したもの
+static float DiscIntegral(float t, float r) {
+  return 0.5f * (t * sqrtf(r * r - t * t) + r * r * asinf(t / r));
+}
+
+// 角の正方形 [0, r] x [0, r] (中心を原点に, 外向きを正にとる) のうち
+// [u0, u1] x [v0, v1] にあって円の外に出ている部分の面積
+static float CornerCut(float u0, float u1, float v0, float v1, float r) {
+  u0 = u0 > 0.0f ? u0 : 0.0f;
+  v0 = v0 > 0.0f ? v0 : 0.0f;
+  u1 = u1 < r ? u1 : r;
+  v1 = v1 < r ? v1 : r;
+  if (u1 <= u0 || v1 <= v0)
+    return 0.0f;
+  // 小さい解像度では角がまるごと 1 つのピクセルに入ることが多い
+  if (u0 == 0.0f && v0 == 0.0f && u1 == r && v1 == r)
+    return CORNER_CUT * r * r;
+  // u < ua では v1 まで円の中, ub < u では v0 から外
+  float ua = sqrtf(r * r - v1 * v1);
+  float ub = sqrtf(r * r - v0 * v0);
+  float inside = 0.0f;
+  float lo = u0, hi = u1 < ub ? u1 : ub;
+  if (ua > lo) {
+    float m = ua < u1 ? ua : u1;
+    inside += (m - lo) * (v1 - v0);
+    lo = m;
+  }
+  if (hi > lo)
+    inside += DiscIntegral(hi, r) - DiscIntegral(lo, r) - (hi - lo) * v0;
+  return (u1 - u0) * (v1 - v0) - inside;
+}
+
+// 出力のピクセル p (大きさ 1 / scale) を, 画面座標で center にある角の円の
+// 中心から dir の向きへの距離の範囲 [e0, e1] に直す
+static void CornerSpan(int p, float inv_scale, float center, float dir,
+                       float *e0, float *e1) {
+  float a = (p * inv_scale - center) * dir;
+  float b = ((p + 1) * inv_scale - center) * dir;
+  *e0 = a < b ? a : b;
+  *e1 = a < b ? b : a;
+}
+
+// 列 [c0, c1) のピクセルについて, 横の中心 center, 向き dir の角で
+// 欠ける割合を cut に足す. 縦の範囲 [v0, v1] は行で共通
+static void AddCornerCut(float *cut, int c0, int c1, float inv_scale,
+                         float center, float dir, float v0, float v1, float r,
+                         float area_scale) {
+  for (int p = c0; p < c1; p++) {
+    float u0, u1;
+    CornerSpan(p, inv_scale, center, dir, &u0, &u1);
+    cut[p] += CornerCut(u0, u1, v0, v1, r) * area_scale;
+  }
+}
+
+// 軸に沿った長方形 (左上 x, y と幅 rw, 高さ rh) を角の半径 radius で丸めて
+// fill で塗る. 覆う割合は x と y の重なりの積から, 角の r x r にかかる
+// ピクセルだけ円の外に出た分を引いたもので, どちらも厳密な面積平均になる.
+// 角は画面座標で丸めるので, 画像の縦横比が画面と違えば楕円の弧になる.
+// border > 0 なら内側に幅 border の枠を edge, 不透明度 edge_alpha で重ねる
+// (raylib の DrawRectangleLinesEx と同じく枠の角は丸めない). 角で欠ける部分は
+// 辺から 0.3 x radius 以内にあるので, border がそれより太いか edge_alpha が 0
+// なら, 枠との重なりも含めて厳密になる.
+static void DrawBox(const Raster *raster, uint8_t *out, float x, float y,
+                    float rw, float rh, float radius, Pixel fill, float border,
+                    Pixel edge, float edge_alpha) {
+  const int w = raster->width;
+  const int h = raster->height;
+  const int ch = raster->channels;
+  const float sx = raster->scale_x;
+  const float sy = raster->scale_y;
+  float ox0 = x * sx;
+  float ox1 = (x + rw) * sx;
+  float oy0 = y * sy;
+  float oy1 = (y + rh) * sy;
+  float ix0 = ox0, ix1 = ox1, iy0 = oy0, iy1 = oy1;
+  if (border > 0.0f) {
+    ix0 = (x + border) * sx;
+    ix1 = (x + rw - border) * sx;
+    iy0 = (y + border) * sy;
+    iy1 = (y + rh - border) * sy;
+    if (ix1 < ix0)
+      ix1 = ix0;
+    if (iy1 < iy0)
+      iy1 = iy0;
+  }
+
+  int px0 = FloorClamp(ox0, w);
+  int px1 = CeilClamp(ox1, w);
+  int py0 = FloorClamp(oy0, h);
+  int py1 = CeilClamp(oy1, h);
+  if (px0 >= px1 || py0 >= py1)
+    return;
+
+  float r = radius;
+  if (r > rw * 0.5f)
+    r = rw * 0.5f;
+  if (r > rh * 0.5f)
+    r = rh * 0.5f;
+  // 角 1 つで欠ける面積 (出力のピクセル単位) が 1/512 に満たなければ,
+  // どの色でも 0.5 段も変わらないので直角のまま塗る
+  if (r * sx * r * sy * CORNER_CUT < 1.0f / 512.0f)
+    r = 0.0f;
+  const float inv_sx = 1.0f / sx;
+  const float inv_sy = 1.0f / sy;
+  // 角にかかる行 [py0, ct) と [cb, py1), 列 [px0, cl) と [cr, px1)
+  int cl = px0, cr = px1, ct = py0, cb = py1;
+  if (r > 0.0f) {
+    cl = CeilClamp((x + r) * sx, w);
+    cr = FloorClamp((x + rw - r) * sx, w);
+    ct = CeilClamp((y + r) * sy, h);
+    cb = FloorClamp((y + rh - r) * sy, h);
+  }
+
+  float cov_outer[RASTER_MAX_W];
+  float cov_inner[RASTER_MAX_W];
+  float cut[RASTER_MAX_W];
+  for (int px = px0; px < px1; px++) {
+    cov_outer[px] = Overlap(ox0, ox1, px);
+    cov_inner[px] = Overlap(ix0, ix1, px);
+    cut[px] = 0.0f;
+  }
+  for (int py = py0; py < py1; py++) {
+    uint8_t *row = out + ((size_t)py * w + px0) * ch;
+    float cy_outer = Overlap(oy0, oy1, py);
+    float cy_inner = Overlap(iy0, iy1, py);
+    // 長方形が小さければ 1 つのピクセルに角が 2 つ以上かかる
+    // (cl > cr や ct > cb になる) ので, 角ごとに足し込む
+    bool corner = py < ct || py >= cb;
+    if (py < ct) {
+      float v0, v1;
+      CornerSpan(py, inv_sy, y + r, -1.0f, &v0, &v1);
+      AddCornerCut(cut, px0, cl, inv_sx, x + r, -1.0f, v0, v1, r, sx * sy);
+      AddCornerCut(cut, cr, px1, inv_sx, x + rw - r, 1.0f, v0, v1, r, sx * sy);
+    }
+    if (py >= cb) {
+      float v0, v1;
+      CornerSpan(py, inv_sy, y + rh - r, 1.0f, &v0, &v1);
+      AddCornerCut(cut, px0, cl, inv_sx, x + r, -1.0f, v0, v1, r, sx * sy);
+      AddCornerCut(cut, cr, px1, inv_sx, x + rw - r, 1.0f, v0, v1, r, sx * sy);
+    }
+    if (ch == RASTER_RGB)
+      BoxRow(row, px1 - px0, RASTER_RGB, cov_outer + px0, cov_inner + px0,
+             cut + px0, cy_outer, cy_inner, edge_alpha, fill.v, edge.v);
+    else
+      BoxRow(row, px1 - px0, RASTER_GRAY, cov_outer + px0, cov_inner + px0,
+             cut + px0, cy_outer, cy_inner, edge_alpha, fill.v, edge.v);
+    if (corner) {
+      for (int px = px0; px < cl; px++)
+        cut[px] = 0.0f;
+      for (int px = cr; px < px1; px++)
+        cut[px] = 0.0f;
+    }
+  }
+}
+
+// raylib の DrawRectangleRounded と同じく, 角の半径は短い辺 x roundness / 2
+static void DrawRect(const Raster *raster, uint8_t *out, Rect rect,
+                     float roundness, Pixel fill, float border, Pixel edge,
+                     float edge_alpha) {
+  float rw = RealToFloat(rect.width);
+  float rh = RealToFloat(rect.height);
+  float radius = (rw < rh ? rw : rh) * roundness * 0.5f;
+  DrawBox(raster, out, RealToFloat(rect.x), RealToFloat(rect.y), rw, rh,
+          radius, fill, border, edge, edge_alpha);
+}
+
+// 円. ring > 0 なら外周 ring の幅を ring_color で塗る.
+// 画像の縦横比が画面と違っても, 標本点を画面座標に戻して判定するので楕円になる
+static void DrawDisc(const Raster *raster, uint8_t *out, Vec2 pos, float radius,
+                     float ring, Pixel fill, Pixel ring_color, float alpha) {
+  const int w = raster->width;
+  const int h = raster->height;
+  const int ch = raster->channels;
+  const float cx = RealToFloat(pos.x);
+  const float cy = RealToFloat(pos.y);
+  int px0 = FloorClamp((cx - radius) * raster->scale_x, w);
+  int px1 = CeilClamp((cx + radius) * raster->scale_x, w);
+  int py0 = FloorClamp((cy - radius) * raster->scale_y, h);
+  int py1 = CeilClamp((cy + radius) * raster->scale_y, h);
+  float r2 = radius * radius;
+  float inner_r = radius - ring > 0.0f ? radius - ring : 0.0f;
+  float inner2 = ring > 0.0f ? inner_r * inner_r : r2;
+  float step_x = 1.0f / (raster->scale_x * SUBSAMPLES);
+  float step_y = 1.0f / (raster->scale_y * SUBSAMPLES);
+  float weight = alpha / (SUBSAMPLES * SUBSAMPLES);
+
+  for (int y = py0; y < py1; y++) {
+    float sy0 = (float)y / raster->scale_y + step_y * 0.5f - cy;
+    uint8_t *px = out + ((size_t)y * w + px0) * ch;
+    for (int x = px0; x < px1; x++, px += ch) {
+      float sx0 = (float)x / raster->scale_x + step_x * 0.5f - cx;
+      int n_fill = 0;
+      int n_ring = 0;
+      for (int j = 0; j < SUBSAMPLES; j++) {
+        float dy = sy0 + step_y * j;
+        for (int i = 0; i < SUBSAMPLES; i++) {
+          float dx = sx0 + step_x * i;
+          float d2 = dx * dx + dy * dy;
+          n_fill += d2 <= inner2;
+          n_ring += d2 > inner2 && d2 <= r2;
+        }
+      }
+      if (n_fill + n_ring == 0)
+        continue;
+      float cf = n_fill * weight;
+      float cr = n_ring * weight;
+      float keep = 1.0f - cf - cr;
+      for (int c = 0; c < ch; c++) {
+        float v = px[c] * keep + fill.v[c] * cf + ring_color.v[c] * cr;
+        px[c] = (uint8_t)(v + 0.5f);
+      }
+    }
+  }
+}
+
+bool RasterInit(Raster *raster, int width, int height, int channels) {
+  memset(raster, 0, sizeof(*raster));
+  if (width <= 0 || height <= 0 || width > RASTER_MAX_W ||
+      height > RASTER_MAX_H ||
+      (channels != RASTER_GRAY && channels != RASTER_RGB))
+    return false;
+  raster->background = malloc((size_t)width * height * channels);
+  if (raster->background == NULL)
+    return false;
+  raster->width = width;
+  raster->height = height;
+  raster->channels = channels;
+  raster->scale_x = (float)width / SCREEN_W;
+  raster->scale_y = (float)height / SCREEN_H;
+
+  // main.c と同じ縦のグラデーション (ピクセルの中心の高さで色を取る)
+  Pixel top = ToPixel(raster, (Rgba){10, 25, 35, 255});
+  Pixel bottom = ToPixel(raster, (Rgba){5, 10, 15, 255});
+  for (int y = 0; y < height; y++) {
+    Pixel p = Mix(top, bottom, ((float)y + 0.5f) / height);
+    uint8_t *row = raster->background + (size_t)y * width * channels;
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < channels; c++)
+        row[x * channels + c] = (uint8_t)(p.v[c] + 0.5f);
+    }
+  }
+
+  Pixel frame = ToPixel(raster, (Rgba){30, 38, 45, 255});
+  Pixel field = ToPixel(raster, (Rgba){17, 21, 32, 255});
+  DrawBox(raster, raster->background, PLAY_X - 10, PLAY_Y - 10, PLAY_W + 20,
+          PLAY_H + 20, 0.0f, frame, 0.0f, frame, 0.0f);
+  DrawBox(raster, raster->background, PLAY_X, PLAY_Y, PLAY_W, PLAY_H, 0.0f,
+          field, 0.0f, field, 0.0f);
+  return true;
+}
+
+void RasterFree(Raster *raster) {
+  free(raster->background);
+  raster->background = NULL;
+}
+
+// 描く順序は main.c の DrawWorld と同じ
+void RasterDraw(const Raster *raster, const World *world, uint8_t *out) {
+  memcpy(out, raster->background,
+         (size_t)raster->width * raster->height * raster->channels);
+
+  Pixel black = ToPixel(raster, (Rgba){0, 0, 0, 255});
+  for (int i = 0; i < MAX_BRICKS; i++) {
+    const Brick *brick = &world->bricks[i];
+    if (!brick->alive)
+      continue;
+    Rgba c = BrickColor(brick);
+    // 縁取りは黒を 20% 重ねる
+    DrawRect(raster, out, brick->rect, 0.2f, ToPixel(raster, c), 1.5f, black,
+             0.2f);
+  }
+
+  for (int i = 0; i < MAX_PARTICLES; i++) {
+    const Particle *p = &world->particles[i];
+    if (!p->active)
+      continue;
+    Pixel c = ToPixel(raster, p->color);
+    float life = RealToFloat(p->life);
+    float alpha = life < 1.0f ? life : 1.0f;
+    DrawDisc(raster, out, p->pos, 2.2f, 0.0f, c, c, alpha);
+  }
+
+  // アイテムの文字はこの解像度では潰れるので円だけ描く
+  for (int i = 0; i < MAX_POWERUPS; i++) {
+    const Powerup *p = &world->powerups[i];
+    if (!p->active)
+      continue;
+    Pixel c = ToPixel(raster, PowerupColor(p->type));
+    DrawDisc(raster, out, p->pos, RealToFloat(p->radius), 0.0f, c, c, 1.0f);
+  }
+
+  Pixel paddle = ToPixel(raster, (Rgba){130, 190, 255, 255});
+  DrawRect(raster, out, world->paddle, 0.4f, paddle, 0.0f, paddle, 0.0f);
+
+  Pixel ball = ToPixel(raster, (Rgba){255, 238, 88, 255});
+  Pixel ball_rim = Mix(ball, ToPixel(raster, (Rgba){255, 255, 255, 255}), 0.5f);
+  for (int i = 0; i < MAX_BALLS; i++) {
+    const Ball *b = &world->balls[i];
+    if (!b->active)
+      continue;
+    DrawDisc(raster, out, b->pos, RealToFloat(b->radius), 1.0f, ball, ball_rim,
+             1.0f);
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "world.h"
+
+#include <stdint.h>
+
+// OpenGL を使わずに World を小さな画像へ描くソフトウェアラスタライザ.
+// 画面全体 (SCREEN_W x SCREEN_H) を width x height へ縮小した絵を,
+// 各ピクセルを覆う面積の割合で塗ることで直接作る (raylib で描いた画面を
+// 面積平均で縮小したものとほぼ同じになる).
+// 星・文字・画面揺れなどの演出は描かない.
+
+#define RASTER_GRAY 1
+#define RASTER_RGB 3
+#define RASTER_MAX_W 1024
+#define RASTER_MAX_H 1024
+
+typedef struct {
+  int width;
+  int height;
+  // RASTER_GRAY か RASTER_RGB
+  int channels;
+  float scale_x;
+  float scale_y;
+  // 背景とプレイフィールドの枠 (フレームごとにこれを写してから描く)
+  uint8_t *background;
+} Raster;
+
+bool RasterInit(Raster *raster, int width, int height, int channels);
+void RasterFree(Raster *raster);
+// out は width * height * channels バイト (行優先, 詰めて並べる)
+void RasterDraw(const Raster *raster, const World *world, uint8_t *out);
+
+#endif
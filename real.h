@@ -0,0 +1,48 @@
+#ifndef REAL_H
+#define REAL_H
+
+// シミュレーションで使う実数型. 既定は float.
+// -DWORLD_FIXED でビルドすると Q16.16 の固定小数点になり, どの環境で
+// ビルドしても同じ入力からは同じ状態 (WorldHash) になる.
+// 足し算・引き算・比較はそのまま書き, 掛け算・割り算・関数は下の
+// Real* を通す. 描画など world の外では RealToFloat で float に直して使う.
+
+#ifdef WORLD_FIXED
+
+#include "fixed.h"
+
+typedef Fixed Real;
+
+#define REAL(x) FIXED_CONST(x)
+
+static inline Real RealFromInt(int v) { return FixedFromInt(v); }
+static inline Real RealFromFloat(float v) { return FixedFromFloat(v); }
+static inline float RealToFloat(Real v) { return FixedToFloat(v); }
+static inline Real RealMul(Real a, Real b) { return FixedMul(a, b); }
+static inline Real RealDiv(Real a, Real b) { return FixedDiv(a, b); }
+static inline Real RealAbs(Real v) { return FixedAbs(v); }
+static inline Real RealSqrt(Real v) { return FixedSqrt(v); }
+static inline Real RealSin(Real v) { return FixedSin(v); }
+static inline Real RealCos(Real v) { return FixedCos(v); }
+
+#else
+
+#include <math.h>
+
+typedef float Real;
+
+#define REAL(x) ((float)(x))
+
+static inline Real RealFromInt(int v) { return (float)v; }
+static inline Real RealFromFloat(float v) { return v; }
+static inline float RealToFloat(Real v) { return v; }
+static inline Real RealMul(Real a, Real b) { return a * b; }
+static inline Real RealDiv(Real a, Real b) { return a / b; }
+static inline Real RealAbs(Real v) { return fabsf(v); }
+static inline Real RealSqrt(Real v) { return sqrtf(v); }
+static inline Real RealSin(Real v) { return sinf(v); }
+static inline Real RealCos(Real v) { return cosf(v); }
+
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+#include "spritebatch.h"
+#include "rlgl.h"
+
+#define ATLAS_CELLS 7
+#define BIG_RADIUS 31
+#define SMALL_RADIUS 4
+
+static Rectangle CellRect(int cell, int size) {
+  return (Rectangle){(float)(cell * SPRITE_CELL + 1), 1.0f, (float)size,
+                     (float)size};
+}
+
+bool SpriteBatchInit(SpriteBatch *batch, Font font) {
+  int big = BIG_RADIUS * 2 + 2;
+  Image img = GenImageColor(ATLAS_CELLS * SPRITE_CELL, SPRITE_CELL, BLANK);
+
+  // セル0-5: アイテムのアイコン (色付きの円 + 文字)
+  for (int t = 0; t <= POWER_DEATH; t++) {
+    Rectangle cell = CellRect(t, big);
+    Vector2 center = {cell.x + big * 0.5f, cell.y + big * 0.5f};
+    Rgba pc = PowerupColor((PowerType)t);
+    ImageDrawCircleV(&img, center, BIG_RADIUS,
+                     (Color){pc.r, pc.g, pc.b, pc.a});
+    const char label[2] = {PowerupLabel((PowerType)t), '\0'};
+    Vector2 size = MeasureTextEx(font, label, 42.0f, 1.0f);
+    ImageDrawTextEx(&img, font, label,
+                    (Vector2){center.x - size.x * 0.5f,
+                              center.y - size.y * 0.5f},
+                    42.0f, 1.0f, BLACK);
+    batch->icon_src[t] = cell;
+  }
+
+  // セル6: 白い小さい円 (色は頂点カラーで付ける). パーティクルは数ピクセル
+  // なので, 大きい円を縮小するより専用に描いた方がきれいに見える
+  int small = SMALL_RADIUS * 2 + 1;
+  batch->small_circle_src = CellRect(1 + POWER_DEATH, small);
+  ImageDrawCircleV(&img,
+                   (Vector2){batch->small_circle_src.x + SMALL_RADIUS,
+                             batch->small_circle_src.y + SMALL_RADIUS},
+                   SMALL_RADIUS, WHITE);
+
+  batch->atlas = LoadTextureFromImage(img);
+  UnloadImage(img);
+  if (batch->atlas.id == 0)
+    return false;
+  SetTextureFilter(batch->atlas, TEXTURE_FILTER_BILINEAR);
+  batch->enabled = true;
+  return true;
+}
+
+void SpriteBatchUnload(SpriteBatch *batch) {
+  if (batch->atlas.id != 0)
+    UnloadTexture(batch->atlas);
+  batch->atlas.id = 0;
+  batch->enabled = false;
+}
+
+void SpriteBatchBegin(SpriteBatch *batch) {
+  rlSetTexture(batch->atlas.id);
+  rlBegin(RL_QUADS);
+  rlNormal3f(0.0f, 0.0f, 1.0f);
+  batch->batches++;
+}
+
+// 頂点ごとに色を渡すので, フェードもテクスチャの切り替えなしに済む.
+// DrawTexturePro と同じく1枚ごとに rlgl のバッチの空きを確かめる.
+// あふれると rlgl がその場で描いて (テクスチャとモードは引き継がれる)
+// 描画呼び出しが1回増えるので数えておく
+void SpriteBatchDraw(SpriteBatch *batch, Rectangle src, Vector2 center,
+                     float radius, Color color) {
+  if (rlCheckRenderBatchLimit(4))
+    batch->batches++;
+  float w = (float)batch->atlas.width;
+  float h = (float)batch->atlas.height;
+  float u0 = src.x / w;
+  float v0 = src.y / h;
+  float u1 = (src.x + src.width) / w;
+  float v1 = (src.y + src.height) / h;
+  float x0 = center.x - radius;
+  float y0 = center.y - radius;
+  float x1 = center.x + radius;
+  float y1 = center.y + radius;
+
+  rlColor4ub(color.r, color.g, color.b, color.a);
+  rlTexCoord2f(u0, v0);
+  rlVertex2f(x0, y0);
+  rlTexCoord2f(u0, v1);
+  rlVertex2f(x0, y1);
+  rlTexCoord2f(u1, v1);
+  rlVertex2f(x1, y1);
+  rlTexCoord2f(u1, v0);
+  rlVertex2f(x1, y0);
+  batch->sprites++;
+  batch->vertices += 4;
+}
+
+void SpriteBatchEnd(SpriteBatch *batch) {
+  (void)batch;
+  rlEnd();
+  rlSetTexture(0);
+}
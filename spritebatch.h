@@ -0,0 +1,33 @@
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include "raylib.h"
+#include "world.h"
+
+// 円とアイテムアイコンを事前に描いておいた1枚のテクスチャ (アトラス) から
+// 四角形として描くことで, パーティクルとアイテムを1回のバッチで描画する.
+#define SPRITE_CELL 66
+
+typedef struct {
+  Texture2D atlas;
+  Rectangle small_circle_src;
+  Rectangle icon_src[POWER_DEATH + 1];
+  bool enabled;
+  // 直近フレームの計測値. batches はアトラスで描くときは実際に
+  // 描画を送った回数, 従来の描き方ではテクスチャの切り替えからの見積もり
+  int batches;
+  int sprites;
+  int vertices;
+  double submit_ms;
+  double submit_ms_avg;
+} SpriteBatch;
+
+bool SpriteBatchInit(SpriteBatch *batch, Font font);
+void SpriteBatchUnload(SpriteBatch *batch);
+
+void SpriteBatchBegin(SpriteBatch *batch);
+void SpriteBatchDraw(SpriteBatch *batch, Rectangle src, Vector2 center,
+                     float radius, Color color);
+void SpriteBatchEnd(SpriteBatch *batch);
+
+#endif
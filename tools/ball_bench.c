@@ -0,0 +1,275 @@
+// ボールの当たり判定の並列化 (WorldSolveBalls / WorldMergeBalls) を,
+// ボール数を増やしたワールドで測る. スレッド数 1, 2, 4, ... ごとに同じ
+// 初期状態から進め, かかった時間と最後の状態のハッシュを出す.
+// ハッシュはスレッド数によらず一致しなければならない. 出来事も毎フレーム
+// 処理し, 得点と残りのブロック数が実際に壊れたブロックと合うかを確かめる.
+//
+//   ./tools/ball_bench [--balls N] [--frames N] [--threads MAX]
+#define _POSIX_C_SOURCE 200809L
+
+#include "../world.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+// この間隔でブロックを元に戻し, 当たり判定の量を保つ
+#define REVIVE_FRAMES 240
+
+typedef struct Bench Bench;
+
+typedef struct {
+  Bench *bench;
+  int index;
+} WorkerArg;
+
+struct Bench {
+  World world;
+  Brick initial[MAX_BRICKS];
+  Ball *balls;
+  BallContact *contacts;
+  WorldEvent *events;
+  int count;
+  int threads;
+  Real dt;
+  bool quit;
+  pthread_barrier_t start;
+  pthread_barrier_t done;
+  WorkerArg args[MAX_THREADS];
+};
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint32_t NextRandom(uint32_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// 落ちたボールはフレームの終わりに決まった位置から打ち直す
+static void SpawnBall(Ball *ball, uint32_t *rng) {
+  uint32_t r = NextRandom(rng);
+  Real angle = RealMul(RealFromInt(30 + (int)(r % 121)), REAL(DEG2RAD));
+  ball->active = true;
+  ball->stuck = false;
+  ball->radius = REAL(BALL_RADIUS);
+  ball->pos = (Vec2){RealFromInt(PLAY_X + 20 + (int)((r >> 8) % (PLAY_W - 40))),
+                     RealFromInt(PLAY_Y + PLAY_H / 2 +
+                                 (int)((r >> 20) % (PLAY_H / 3)))};
+  ball->vel = (Vec2){RealCos(angle), -RealSin(angle)};
+}
+
+static void SolveRange(Bench *bench, int index) {
+  int per = bench->count / bench->threads;
+  int extra = bench->count % bench->threads;
+  int begin = index * per + (index < extra ? index : extra);
+  int end = begin + per + (index < extra ? 1 : 0);
+  WorldSolveBalls(&bench->world, bench->balls, bench->contacts, begin, end,
+                  bench->dt);
+}
+
+static void *Worker(void *p) {
+  WorkerArg *arg = p;
+  Bench *bench = arg->bench;
+  for (;;) {
+    pthread_barrier_wait(&bench->start);
+    if (bench->quit)
+      return NULL;
+    SolveRange(bench, arg->index);
+    pthread_barrier_wait(&bench->done);
+  }
+}
+
+static uint64_t HashBench(const Bench *bench) {
+  uint64_t hash = WorldHash(&bench->world, 0);
+  for (int i = 0; i < bench->count; i++) {
+    const Ball *b = &bench->balls[i];
+    Real v[4] = {b->pos.x, b->pos.y, b->vel.x, b->vel.y};
+    const unsigned char *bytes = (const unsigned char *)v;
+    for (size_t k = 0; k < sizeof(v); k++) {
+      hash ^= bytes[k];
+      hash *= 0x100000001b3ull;
+    }
+    hash ^= (uint64_t)b->active;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static int AliveBreakable(const World *world, int *hp_sum) {
+  int alive = 0;
+  *hp_sum = 0;
+  for (int b = 0; b < MAX_BRICKS; b++) {
+    const Brick *brick = &world->bricks[b];
+    if (brick->alive && !brick->solid) {
+      alive++;
+      *hp_sum += brick->hp;
+    }
+  }
+  return alive;
+}
+
+typedef struct {
+  double solve_sec;
+  double merge_sec;
+  long conflicts;
+  long destroyed;
+  uint64_t hash;
+  bool consistent;
+} RunResult;
+
+static RunResult Run(int count, int frames, int threads) {
+  static Bench bench;
+  memset(&bench.world, 0, sizeof(bench.world));
+  WorldInit(&bench.world, 3, 12345u);
+  bench.world.no_fx = true;
+  memcpy(bench.initial, bench.world.bricks, sizeof(bench.initial));
+  bench.count = count;
+  bench.threads = threads;
+  bench.dt = RealFromFloat(1.0f / 60.0f);
+  bench.quit = false;
+  bench.balls = malloc(sizeof(Ball) * (size_t)count);
+  bench.contacts = malloc(sizeof(BallContact) * (size_t)count);
+  bench.events = malloc(sizeof(WorldEvent) * (size_t)count * EVENTS_PER_BALL);
+  if (bench.balls == NULL || bench.contacts == NULL || bench.events == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  uint32_t rng = 0x9e3779b9u;
+  for (int i = 0; i < count; i++)
+    SpawnBall(&bench.balls[i], &rng);
+
+  pthread_t tids[MAX_THREADS];
+  pthread_barrier_init(&bench.start, NULL, (unsigned)threads);
+  pthread_barrier_init(&bench.done, NULL, (unsigned)threads);
+  for (int t = 1; t < threads; t++) {
+    bench.args[t] = (WorkerArg){&bench, t};
+    pthread_create(&tids[t], NULL, Worker, &bench.args[t]);
+  }
+
+  RunResult result = {.consistent = true};
+  for (int f = 0; f < frames; f++) {
+    World *world = &bench.world;
+    int hp_before;
+    int alive_before = AliveBreakable(world, &hp_before);
+    int score_before = world->score;
+    world->destroyed = 0;
+
+    double t0 = NowSec();
+    if (threads > 1)
+      pthread_barrier_wait(&bench.start);
+    SolveRange(&bench, 0);
+    if (threads > 1)
+      pthread_barrier_wait(&bench.done);
+    double t1 = NowSec();
+    EventBuffer events = {bench.events, 0, count * EVENTS_PER_BALL};
+    result.conflicts += WorldMergeBalls(world, bench.balls, bench.contacts,
+                                        count, bench.dt, &events);
+    double t2 = NowSec();
+    result.solve_sec += t1 - t0;
+    result.merge_sec += t2 - t1;
+
+    // 壊れたブロックは 100 点以上, 壊れずに耐久が減った分は 40 点ずつ
+    WorldDispatchEvents(world, events.events, events.count);
+    int hp_after;
+    int alive_after = AliveBreakable(world, &hp_after);
+    int died = alive_before - alive_after;
+    int damaged = hp_before - hp_after - died;
+    result.destroyed += died;
+    if (world->breakable_left != alive_after || world->destroyed != died ||
+        world->score - score_before < died * 100 + damaged * 40)
+      result.consistent = false;
+
+    for (int i = 0; i < count; i++) {
+      if (!bench.balls[i].active)
+        SpawnBall(&bench.balls[i], &rng);
+    }
+    if ((f + 1) % REVIVE_FRAMES == 0) {
+      for (int b = 0; b < MAX_BRICKS; b++) {
+        bench.world.bricks[b].alive = bench.initial[b].alive;
+        bench.world.bricks[b].hp = bench.initial[b].hp;
+      }
+      int hp_sum;
+      bench.world.breakable_left = AliveBreakable(&bench.world, &hp_sum);
+    }
+  }
+  result.hash = HashBench(&bench);
+
+  bench.quit = true;
+  if (threads > 1)
+    pthread_barrier_wait(&bench.start);
+  for (int t = 1; t < threads; t++)
+    pthread_join(tids[t], NULL);
+  pthread_barrier_destroy(&bench.start);
+  pthread_barrier_destroy(&bench.done);
+  free(bench.events);
+  free(bench.contacts);
+  free(bench.balls);
+  return result;
+}
+
+int main(int argc, char **argv) {
+  int count = 4096;
+  int frames = 600;
+  int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc)
+      count = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      max_threads = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--balls N] [--frames N] [--threads MAX]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (count < 1 || frames < 1) {
+    fprintf(stderr, "--balls and --frames must be positive\n");
+    return 2;
+  }
+  if (count > MAX_MERGE_BALLS) {
+    fprintf(stderr, "--balls must be at most %d\n", MAX_MERGE_BALLS);
+    return 2;
+  }
+  if (max_threads < 1)
+    max_threads = 1;
+  if (max_threads > MAX_THREADS)
+    max_threads = MAX_THREADS;
+
+  printf("balls %d, frames %d\n", count, frames);
+  printf("threads  solve ms  merge ms  speedup  conflicts  destroyed  hash\n");
+  RunResult base = {0};
+  bool same = true;
+  bool consistent = true;
+  for (int t = 1;; t = t * 2 > max_threads && t < max_threads ? max_threads
+                                                               : t * 2) {
+    RunResult r = Run(count, frames, t);
+    if (t == 1)
+      base = r;
+    same = same && r.hash == base.hash;
+    consistent = consistent && r.consistent;
+    double total = r.solve_sec + r.merge_sec;
+    printf("%7d  %8.1f  %8.1f  %6.2fx  %9ld  %9ld  %016llx\n", t,
+           r.solve_sec * 1e3, r.merge_sec * 1e3,
+           (base.solve_sec + base.merge_sec) / total, r.conflicts,
+           r.destroyed, (unsigned long long)r.hash);
+    if (t >= max_threads)
+      break;
+  }
+  printf("%s: hashes %s across thread counts\n", same ? "OK" : "FAIL",
+         same ? "match" : "differ");
+  printf("%s: score and bricks left %s destroyed bricks\n",
+         consistent ? "OK" : "FAIL", consistent ? "match" : "do not match");
+  return same && consistent ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+// 動くブロックの当たり判定を, 全ブロックを毎回調べる方法と
+// BVH (毎フレーム差分で箱を直し, 質が落ちたら作り直す) で比べる.
+// どちらも各ボールについて「当たっている中で番号が最小のブロック」を求め,
+// その合計が一致することも確かめる.
+//
+//   ./tools/bvh_bench [--balls N] [--frames N]
+#define _POSIX_C_SOURCE 200809L
+
+#include "../bvh.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BOX_W 20.0f
+#define BOX_H 10.0f
+#define CELL_W 28.0f
+#define CELL_H 16.0f
+#define BALL_RADIUS 8.0f
+#define MARGIN 4.0f
+
+typedef struct {
+  float home_x;
+  float home_y;
+  int motion;
+  float amp;
+  float phase;
+} Mover;
+
+typedef struct {
+  float x;
+  float y;
+  float vx;
+  float vy;
+} Ball;
+
+static uint32_t rng = 0x12345678u;
+
+static float RandomUnit(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return (float)(rng >> 8) / 16777216.0f;
+}
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool CircleHitsBox(float cx, float cy, float r, Aabb b) {
+  float nx = cx < b.min_x ? b.min_x : (cx > b.max_x ? b.max_x : cx);
+  float ny = cy < b.min_y ? b.min_y : (cy > b.max_y ? b.max_y : cy);
+  float dx = cx - nx;
+  float dy = cy - ny;
+  return dx * dx + dy * dy <= r * r;
+}
+
+// ゲームと同じく, 横の往復・円運動・止まったままを混ぜる
+static void MoveBoxes(const Mover *movers, Aabb *boxes, int n, float t) {
+  for (int i = 0; i < n; i++) {
+    const Mover *m = &movers[i];
+    float x = m->home_x;
+    float y = m->home_y;
+    if (m->motion == 1) {
+      x += m->amp * sinf(t * 1.2f + m->phase);
+    } else if (m->motion == 2) {
+      x += m->amp * cosf(t * 2.0f + m->phase);
+      y += m->amp * sinf(t * 2.0f + m->phase);
+    }
+    boxes[i] = (Aabb){x, y, x + BOX_W, y + BOX_H};
+  }
+}
+
+static void MoveBalls(Ball *balls, int n, float w, float h, float dt) {
+  for (int i = 0; i < n; i++) {
+    Ball *b = &balls[i];
+    b->x += b->vx * dt;
+    b->y += b->vy * dt;
+    if (b->x < 0.0f || b->x > w)
+      b->vx = -b->vx;
+    if (b->y < 0.0f || b->y > h)
+      b->vy = -b->vy;
+  }
+}
+
+static uint64_t BruteFrame(const Aabb *boxes, int n, const Ball *balls,
+                           int ball_count) {
+  uint64_t sum = 0;
+  for (int i = 0; i < ball_count; i++) {
+    for (int b = 0; b < n; b++) {
+      if (CircleHitsBox(balls[i].x, balls[i].y, BALL_RADIUS, boxes[b])) {
+        sum += (uint64_t)b + 1;
+        break;
+      }
+    }
+  }
+  return sum;
+}
+
+static uint64_t BvhFrame(Bvh bvh, const Aabb *boxes, const Ball *balls,
+                         int ball_count, int *scratch, int *candidates,
+                         int max_candidates) {
+  BvhUpdate(bvh, boxes, scratch);
+  uint64_t sum = 0;
+  for (int i = 0; i < ball_count; i++) {
+    const Ball *ball = &balls[i];
+    Aabb q = {ball->x - BALL_RADIUS, ball->y - BALL_RADIUS,
+              ball->x + BALL_RADIUS, ball->y + BALL_RADIUS};
+    int count =
+        BvhQuery(bvh.nodes, bvh.info, q, candidates, max_candidates);
+    int hit = -1;
+    for (int c = 0; c < count; c++) {
+      int b = candidates[c];
+      if (hit >= 0 && b > hit)
+        continue;
+      if (CircleHitsBox(ball->x, ball->y, BALL_RADIUS, boxes[b]))
+        hit = b;
+    }
+    if (hit >= 0)
+      sum += (uint64_t)hit + 1;
+  }
+  return sum;
+}
+
+static void RunCase(int n, int ball_count, int frames) {
+  int cols = (int)ceilf(sqrtf((float)n * 2.0f));
+  int rows = (n + cols - 1) / cols;
+  float w = cols * CELL_W;
+  float h = rows * CELL_H;
+
+  Mover *movers = malloc(sizeof(Mover) * (size_t)n);
+  Aabb *boxes = malloc(sizeof(Aabb) * (size_t)n);
+  BvhNode *nodes = malloc(sizeof(BvhNode) * (size_t)(2 * n));
+  int *leaf_of = malloc(sizeof(int) * (size_t)n);
+  int *scratch = malloc(sizeof(int) * (size_t)n);
+  int *candidates = malloc(sizeof(int) * (size_t)n);
+  Ball *balls = malloc(sizeof(Ball) * (size_t)ball_count);
+  BvhInfo info = {0};
+  Bvh bvh = {nodes, leaf_of, &info};
+
+  rng = 0x12345678u;
+  for (int i = 0; i < n; i++) {
+    Mover *m = &movers[i];
+    m->home_x = (i % cols) * CELL_W;
+    m->home_y = (i / cols) * CELL_H;
+    // 行ごとに動き方を決める (ゲームの面と同じく行単位で動く)
+    int row = i / cols;
+    m->motion = row % 3;
+    m->amp = m->motion == 1 ? 40.0f : 6.0f;
+    m->phase = (float)(row % 7);
+  }
+  for (int i = 0; i < ball_count; i++) {
+    float ang = RandomUnit() * 6.2831853f;
+    balls[i] = (Ball){RandomUnit() * w, RandomUnit() * h, cosf(ang) * 430.0f,
+                      sinf(ang) * 430.0f};
+  }
+  Ball *balls_start = malloc(sizeof(Ball) * (size_t)ball_count);
+  memcpy(balls_start, balls, sizeof(Ball) * (size_t)ball_count);
+
+  const float dt = 1.0f / 60.0f;
+  MoveBoxes(movers, boxes, n, 0.0f);
+
+  uint64_t brute_sum = 0;
+  double t0 = NowSec();
+  for (int f = 0; f < frames; f++) {
+    MoveBoxes(movers, boxes, n, f * dt);
+    MoveBalls(balls, ball_count, w, h, dt);
+    brute_sum += BruteFrame(boxes, n, balls, ball_count);
+  }
+  double brute = NowSec() - t0;
+
+  memcpy(balls, balls_start, sizeof(Ball) * (size_t)ball_count);
+  MoveBoxes(movers, boxes, n, 0.0f);
+  BvhBuild(bvh, boxes, n, MARGIN, scratch);
+  info.rebuilds = 0;
+  uint64_t bvh_sum = 0;
+  t0 = NowSec();
+  for (int f = 0; f < frames; f++) {
+    MoveBoxes(movers, boxes, n, f * dt);
+    MoveBalls(balls, ball_count, w, h, dt);
+    bvh_sum += BvhFrame(bvh, boxes, balls, ball_count, scratch, candidates, n);
+  }
+  double tree = NowSec() - t0;
+
+  // 動かす処理は両方に含まれるので, その分を別に測って差し引く
+  t0 = NowSec();
+  for (int f = 0; f < frames; f++) {
+    MoveBoxes(movers, boxes, n, f * dt);
+    MoveBalls(balls, ball_count, w, h, dt);
+  }
+  double move = NowSec() - t0;
+
+  double brute_us = (brute - move) * 1e6 / frames;
+  double tree_us = (tree - move) * 1e6 / frames;
+  if (brute_us < 0.0)
+    brute_us = 0.0;
+  if (tree_us < 0.01)
+    tree_us = 0.01;
+  printf("%6d %6d %12.1f %12.1f %8.1fx %7d %8d %7.2f  %s\n", n, ball_count,
+         brute_us, tree_us, brute_us / tree_us, info.refits, info.rebuilds,
+         info.cost / (info.build_cost > 0.0f ? info.build_cost : 1.0f),
+         brute_sum == bvh_sum ? "match" : "MISMATCH");
+
+  free(balls_start);
+  free(balls);
+  free(candidates);
+  free(scratch);
+  free(leaf_of);
+  free(nodes);
+  free(boxes);
+  free(movers);
+}
+
+int main(int argc, char **argv) {
+  int ball_count = 64;
+  int frames = 300;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc)
+      ball_count = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--balls N] [--frames N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (ball_count < 1 || frames < 1) {
+    fprintf(stderr, "--balls and --frames must be positive\n");
+    return 2;
+  }
+
+  static const int sizes[] = {96, 256, 1024, 4096, 16384};
+  printf("bricks  balls  brute us/fr    bvh us/fr  speedup  refits rebuilds"
+         "  cost\n");
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    RunCase(sizes[i], ball_count, frames);
+  return 0;
+}
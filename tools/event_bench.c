@@ -0,0 +1,208 @@
+// 当たり判定の出来事 (WorldEvent) の量と処理速度を測る.
+//   sim:      ボール4個 (マルチボール状態) のワールドをボットで進め,
+//            1フレームあたりの出来事の数と種類ごとの内訳, 1秒あたりに
+//            出て処理された出来事の数を出す.
+//   dispatch: 種類を混ぜた MAX_EVENTS 個の出来事を WorldDispatchEvents に
+//            繰り返し渡し, 演出あり / なしでの1件あたりの時間を出す.
+//
+//   ./tools/event_bench [--worlds N] [--frames N] [--iters N]
+#define _POSIX_C_SOURCE 200809L
+
+#include "../world.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EVENT_TYPES (EVENT_BALL_LOST + 1)
+
+static const char *event_names[EVENT_TYPES] = {
+    "wall hit", "paddle hit", "brick hit", "brick destroyed", "ball lost",
+};
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// 一番低いところにあるボールを追うボット
+static uint8_t BotInput(const World *world) {
+  int target = -1;
+  int lowest = -1;
+  for (int i = 0; i < MAX_BALLS; i++) {
+    const Ball *b = &world->balls[i];
+    if (!b->active || b->stuck)
+      continue;
+    int y = (int)RealToFloat(b->pos.y);
+    if (y > lowest) {
+      lowest = y;
+      target = (int)RealToFloat(b->pos.x);
+    }
+  }
+  if (target < 0)
+    return INPUT_LAUNCH;
+  int center = (int)RealToFloat(world->paddle.x) +
+               (int)RealToFloat(world->paddle.width) / 2;
+  if (target < center - 8)
+    return INPUT_LEFT;
+  if (target > center + 8)
+    return INPUT_RIGHT;
+  return 0;
+}
+
+// 発射済みのボールを4個にする
+static void StartMultiball(World *world) {
+  static const float angles[MAX_BALLS] = {1.1f, 1.4f, 1.8f, 2.1f};
+  for (int i = 0; i < MAX_BALLS; i++) {
+    Ball *b = &world->balls[i];
+    b->active = true;
+    b->stuck = false;
+    b->radius = REAL(BALL_RADIUS);
+    b->pos = (Vec2){REAL(PLAY_X + PLAY_W * 0.5f), REAL(PLAY_Y + PLAY_H - 80)};
+    b->vel = (Vec2){RealCos(RealFromFloat(angles[i])),
+                    -RealSin(RealFromFloat(angles[i]))};
+  }
+}
+
+static void RunSim(int worlds, int frames) {
+  World *w = malloc(sizeof(World) * (size_t)worlds);
+  if (w == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  for (int i = 0; i < worlds; i++) {
+    WorldInit(&w[i], 1 + i % LEVEL_MOVING, 500u + (uint32_t)i);
+    StartMultiball(&w[i]);
+  }
+
+  long counts[EVENT_TYPES] = {0};
+  long steps = 0;
+  long events = 0;
+  double t0 = NowSec();
+  for (int i = 0; i < worlds; i++) {
+    for (int f = 0; f < frames && w[i].status == WORLD_PLAY; f++) {
+      WorldStep(&w[i], BotInput(&w[i]), 1.0f / 60.0f);
+      steps++;
+      events += w[i].event_count;
+      for (int e = 0; e < w[i].event_count; e++)
+        counts[w[i].events[e].type]++;
+    }
+  }
+  double elapsed = NowSec() - t0;
+
+  printf("sim: %d worlds, %ld steps, %.0f steps/s\n", worlds, steps,
+         (double)steps / elapsed);
+  printf("  %ld events, %.2f per step, %.0f events/s\n", events,
+         steps ? (double)events / (double)steps : 0.0,
+         (double)events / elapsed);
+  for (int t = 0; t < EVENT_TYPES; t++)
+    printf("    %-16s %9ld\n", event_names[t], counts[t]);
+  free(w);
+}
+
+// 壁・パドル・壊せないブロック・壊れるブロック・落下を混ぜた1フレーム分
+static int FillEvents(World *world) {
+  int solid = -1;
+  int breakable[MAX_BRICKS];
+  int n_breakable = 0;
+  for (int i = 0; i < MAX_BRICKS; i++) {
+    const Brick *b = &world->bricks[i];
+    if (!b->alive)
+      continue;
+    if (b->solid)
+      solid = i;
+    else
+      breakable[n_breakable++] = i;
+  }
+  if (n_breakable == 0)
+    return 0;
+  int n = 0;
+  while (n < MAX_EVENTS) {
+    int ball = n % MAX_BALLS;
+    int brick = breakable[(n * 7) % n_breakable];
+    switch (n % 6) {
+    case 0:
+    case 3:
+      world->events[n] = (WorldEvent){EVENT_WALL_HIT, 0, (uint16_t)ball};
+      break;
+    case 1:
+      world->events[n] = (WorldEvent){EVENT_PADDLE_HIT, 0, (uint16_t)ball};
+      break;
+    case 2:
+      world->events[n] = (WorldEvent){EVENT_BRICK_HIT,
+                                      (uint8_t)(solid >= 0 ? solid : brick),
+                                      (uint16_t)ball};
+      break;
+    case 4:
+      world->events[n] =
+          (WorldEvent){EVENT_BRICK_DESTROYED, (uint8_t)brick, (uint16_t)ball};
+      break;
+    default:
+      world->events[n] = (WorldEvent){EVENT_BALL_LOST, 0, (uint16_t)ball};
+      break;
+    }
+    n++;
+  }
+  return n;
+}
+
+static void RunDispatch(int iters, bool fx) {
+  static World world;
+  WorldInit(&world, 3, 99u);
+  world.no_fx = !fx;
+  int n = FillEvents(&world);
+  if (n == 0)
+    return;
+  int breakable = world.breakable_left;
+
+  double t0 = NowSec();
+  for (int it = 0; it < iters; it++) {
+    world.event_count = n;
+    world.sfx = 0;
+    world.destroyed = 0;
+    world.score = 0;
+    world.combo = 0;
+    world.breakable_left = breakable;
+    WorldDispatchEvents(&world, world.events, world.event_count);
+    // パーティクルとアイテムの空きを戻して毎回同じ量の仕事をさせる
+    for (int i = 0; i < MAX_PARTICLES; i++)
+      world.particles[i].active = false;
+    for (int i = 0; i < MAX_POWERUPS; i++)
+      world.powerups[i].active = false;
+  }
+  double elapsed = NowSec() - t0;
+  double total = (double)n * iters;
+  printf("dispatch (%s): %d events x %d batches, %.1f ns/event, "
+         "%.0f M events/s\n",
+         fx ? "fx on" : "fx off", n, iters, elapsed * 1e9 / total,
+         total / elapsed * 1e-6);
+}
+
+int main(int argc, char **argv) {
+  int worlds = 64;
+  int frames = 3600;
+  int iters = 200000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--worlds") == 0 && i + 1 < argc)
+      worlds = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc)
+      iters = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--worlds N] [--frames N] [--iters N]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (worlds < 1 || frames < 1 || iters < 1) {
+    fprintf(stderr, "all counts must be positive\n");
+    return 2;
+  }
+  RunSim(worlds, frames);
+  RunDispatch(iters, false);
+  RunDispatch(iters, true);
+  return 0;
+}
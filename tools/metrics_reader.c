@@ -0,0 +1,241 @@
+// ゲームが共有メモリに書き出す統計 (metrics.h) を読むツール.
+//   ./tools/metrics_reader                 1秒ごとに最新の値を表示
+//   ./tools/metrics_reader --csv > log.csv 新しいフレームごとに1行 (CSV)
+//   ./tools/metrics_reader --bench         書き込みの速さとシーケンスロックを確認
+//
+// オプション: [--name NAME] [--hz N] [--count N] [--csv] [--bench]
+// ゲーム側は ./pong --metrics で書き出しを始める.
+#define _POSIX_C_SOURCE 200809L
+
+#include "../metrics.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_FRAMES 2000000
+
+static const char *state_names[] = {"menu",  "play", "pause",
+                                    "clear", "over", "versus"};
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void SleepSec(double sec) {
+  struct timespec ts = {(time_t)sec, (long)((sec - (time_t)sec) * 1e9)};
+  nanosleep(&ts, NULL);
+}
+
+static const char *StateName(int32_t state) {
+  int n = (int)(sizeof(state_names) / sizeof(*state_names));
+  if (state < 0 || state >= n)
+    return "?";
+  return state_names[state];
+}
+
+static void PrintCsvHeader(void) {
+  printf("time,frame,fps,p50_ms,p95_ms,p99_ms,max_ms,state,level,score,lives,"
+         "balls,particles,powerups,music_update_gaps\n");
+}
+
+static void PrintCsv(const MetricsSample *s) {
+  printf("%.6f,%llu,%.2f,%.3f,%.3f,%.3f,%.3f,%s,%d,%d,%d,%d,%d,%d,%u\n",
+         s->time_sec, (unsigned long long)s->frame, s->fps, s->frame_ms_p50,
+         s->frame_ms_p95, s->frame_ms_p99, s->frame_ms_max,
+         StateName(s->state), s->level, s->score, s->lives, s->balls,
+         s->particles, s->powerups, s->music_update_gaps);
+}
+
+static void PrintHuman(const MetricsSample *s, long reads, long retries,
+                       long busy) {
+  printf("frame %llu  %6.1f fps  frame ms p50 %.2f p95 %.2f p99 %.2f max "
+         "%.2f  %-6s lv %d  score %d  lives %d  balls %d  particles %d  "
+         "items %d  music gaps %u  (%ld reads, %ld retries, %ld busy)\n",
+         (unsigned long long)s->frame, s->fps, s->frame_ms_p50,
+         s->frame_ms_p95, s->frame_ms_p99, s->frame_ms_max,
+         StateName(s->state), s->level, s->score, s->lives, s->balls,
+         s->particles, s->powerups, s->music_update_gaps, reads, retries,
+         busy);
+  fflush(stdout);
+}
+
+static int Sample(const char *name, double hz, long count, bool csv) {
+  const MetricsBlock *block = MetricsAttach(name);
+  if (block == NULL) {
+    fprintf(stderr, "cannot open shared memory '%s' (is ./pong --metrics "
+                    "running?)\n",
+            name);
+    return 1;
+  }
+  if (csv)
+    PrintCsvHeader();
+  double period = 1.0 / hz;
+  double next = NowSec();
+  double last_print = next;
+  double last_change = next;
+  uint64_t last_frame = 0;
+  long reads = 0;
+  long retries = 0;
+  long busy = 0;
+  long samples = 0;
+  MetricsSample s = {0};
+  while (count == 0 || samples < count) {
+    MetricsSample fresh;
+    int r = MetricsRead(block, &fresh);
+    samples++;
+    double now = NowSec();
+    if (r == METRICS_READ_BAD) {
+      fprintf(stderr,
+              "block '%s' is not readable (magic %08x, version %u, "
+              "expected %08x, %d)\n",
+              name, block->magic, block->version, METRICS_MAGIC,
+              METRICS_VERSION);
+      MetricsDetach(block);
+      return 1;
+    }
+    // 書き手が書き込み中に止まっていたら, この回は飛ばして次の周期に読む
+    if (r == METRICS_READ_BUSY) {
+      busy++;
+    } else {
+      reads++;
+      retries += r;
+      s = fresh;
+      if (s.frame != last_frame) {
+        last_frame = s.frame;
+        last_change = now;
+        if (csv)
+          PrintCsv(&s);
+      }
+    }
+    if (!csv && now - last_print >= 1.0) {
+      last_print = now;
+      if (now - last_change > 2.0)
+        printf("(no new frames for %.0f s)\n", now - last_change);
+      else
+        PrintHuman(&s, reads, retries, busy);
+    }
+    next += period;
+    if (next > now)
+      SleepSec(next - now);
+    else
+      next = now;
+  }
+  MetricsDetach(block);
+  return 0;
+}
+
+// ---- --bench ----
+// 書き手は frame から決まる値を書き, 読み手は全項目がそろっているかを見る.
+// そろっていなければシーケンスロックが壊れている
+
+typedef struct {
+  const MetricsBlock *block;
+  atomic_bool stop;
+  long reads;
+  long retries;
+  long busy;
+  long torn;
+} BenchReader;
+
+static void *ReaderThread(void *p) {
+  BenchReader *r = p;
+  MetricsSample s;
+  while (!atomic_load(&r->stop)) {
+    int n = MetricsRead(r->block, &s);
+    if (n == METRICS_READ_BUSY)
+      r->busy++;
+    if (n < 0)
+      continue;
+    r->reads++;
+    r->retries += n;
+    int32_t v = (int32_t)s.frame;
+    if (s.frame != 0 && (s.score != v || s.lives != -v || s.balls != v * 3 ||
+                         s.particles != (v ^ 0x5555) ||
+                         s.music_update_gaps != (uint32_t)v * 7u))
+      r->torn++;
+  }
+  return NULL;
+}
+
+static int Bench(void) {
+  char name[64];
+  snprintf(name, sizeof(name), "/pong_metrics_bench_%d", (int)getpid());
+  static MetricsPublisher pub;
+  if (!MetricsOpen(&pub, name)) {
+    fprintf(stderr, "cannot create shared memory '%s'\n", name);
+    return 1;
+  }
+  BenchReader reader = {MetricsAttach(name), false, 0, 0, 0, 0};
+  if (reader.block == NULL) {
+    fprintf(stderr, "cannot attach '%s'\n", name);
+    MetricsClose(&pub);
+    return 1;
+  }
+  pthread_t tid;
+  pthread_create(&tid, NULL, ReaderThread, &reader);
+
+  double t0 = NowSec();
+  for (int i = 1; i <= BENCH_FRAMES; i++) {
+    MetricsSample s = {0};
+    int32_t v = i;
+    s.state = 1;
+    s.score = v;
+    s.lives = -v;
+    s.balls = v * 3;
+    s.particles = v ^ 0x5555;
+    s.music_update_gaps = (uint32_t)v * 7u;
+    MetricsPublish(&pub, &s, 16.0f + (float)(i % 5));
+  }
+  double elapsed = NowSec() - t0;
+  atomic_store(&reader.stop, true);
+  pthread_join(tid, NULL);
+
+  printf("publish: %d frames, %.1f ns/frame (with a reader spinning)\n",
+         BENCH_FRAMES, elapsed * 1e9 / BENCH_FRAMES);
+  printf("reader:  %ld reads, %ld retries, %ld busy, %ld torn\n",
+         reader.reads, reader.retries, reader.busy, reader.torn);
+  MetricsDetach(reader.block);
+  MetricsClose(&pub);
+  printf("%s\n", reader.torn == 0 ? "OK" : "FAIL: torn reads");
+  return reader.torn == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  const char *name = METRICS_DEFAULT_NAME;
+  double hz = 200.0;
+  long count = 0;
+  bool csv = false;
+  bool bench = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--name") == 0 && i + 1 < argc)
+      name = argv[++i];
+    else if (strcmp(argv[i], "--hz") == 0 && i + 1 < argc)
+      hz = atof(argv[++i]);
+    else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+      count = atol(argv[++i]);
+    else if (strcmp(argv[i], "--csv") == 0)
+      csv = true;
+    else if (strcmp(argv[i], "--bench") == 0)
+      bench = true;
+    else {
+      fprintf(stderr,
+              "usage: %s [--name NAME] [--hz N] [--count N] [--csv] "
+              "[--bench]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (bench)
+    return Bench();
+  if (hz <= 0.0 || count < 0) {
+    fprintf(stderr, "--hz must be positive and --count non-negative\n");
+    return 2;
+  }
+  return Sample(name, hz, count, csv);
+}
@@ -0,0 +1,239 @@
+// 物理の実数型 (real.h) の確認と速度計測.
+//   sim:    レベル 1-4 の World をボットで進め, 全体のハッシュと
+//           1 秒あたりのステップ数を出す. make FIXED=1 でビルドしたものは
+//           コンパイラや最適化オプションを変えてもハッシュが一致するはず.
+//   kernel: 大量のボールを壁で跳ね返しながら進めるだけの処理を,
+//           float と Q16.16 の構造体配列 (SoA) で書いて速さを比べる.
+//           整数版も同じように自動ベクトル化される.
+//
+//   ./tools/physics_bench [--worlds N] [--frames N] [--balls N] [--iters N]
+#define _POSIX_C_SOURCE 200809L
+
+#include "../fixed.h"
+#include "../world.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef WORLD_FIXED
+#define MODE_NAME "fixed Q16.16"
+#else
+#define MODE_NAME "float"
+#endif
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// vs_loopback と同じくボールを追うボット. 判断は整数だけで行い,
+// 入力列が実数型の丸めに左右されにくいようにする
+static uint8_t BotInput(const World *world, uint32_t *rng) {
+  *rng = *rng * 1664525u + 1013904223u;
+  uint8_t input = 0;
+  int target = (int)RealToFloat(world->balls[0].pos.x);
+  for (int i = 0; i < MAX_BALLS; i++) {
+    if (world->balls[i].active && !world->balls[i].stuck) {
+      target = (int)RealToFloat(world->balls[i].pos.x);
+      break;
+    }
+  }
+  target += (int)(*rng >> 24) / 4 - 32;
+  int center = (int)RealToFloat(world->paddle.x) +
+               (int)RealToFloat(world->paddle.width) / 2;
+  if (target < center - 8)
+    input |= INPUT_LEFT;
+  if (target > center + 8)
+    input |= INPUT_RIGHT;
+  if ((*rng >> 8) % 30 == 0)
+    input |= INPUT_LAUNCH;
+  return input;
+}
+
+static void RunSim(int worlds, int frames) {
+  World *w = malloc(sizeof(World) * (size_t)worlds);
+  uint32_t *rng = malloc(sizeof(uint32_t) * (size_t)worlds);
+  if (w == NULL || rng == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  for (int i = 0; i < worlds; i++) {
+    WorldInit(&w[i], 1 + i % LEVEL_MOVING, 1000u + (uint32_t)i);
+    w[i].no_fx = true;
+    rng[i] = 1u + (uint32_t)i;
+  }
+
+  double t0 = NowSec();
+  long steps = 0;
+  for (int i = 0; i < worlds; i++) {
+    for (int f = 0; f < frames && w[i].status == WORLD_PLAY; f++) {
+      WorldStep(&w[i], BotInput(&w[i], &rng[i]), 1.0f / 60.0f);
+      steps++;
+    }
+  }
+  double elapsed = NowSec() - t0;
+
+  uint64_t hash = 0;
+  int cleared = 0;
+  for (int i = 0; i < worlds; i++) {
+    hash = WorldHash(&w[i], hash);
+    cleared += w[i].status == WORLD_CLEAR;
+  }
+  printf("sim [%s]: %d worlds x %d frames, %ld steps, %d cleared\n", MODE_NAME,
+         worlds, frames, steps, cleared);
+  printf("  %.0f steps/s, hash %016llx\n", (double)steps / elapsed,
+         (unsigned long long)hash);
+  free(rng);
+  free(w);
+}
+
+// ---- kernel ----
+// 中身は world.c の UpdateBall の前半 (移動と壁での反射) と同じ.
+// 反射は分岐の代わりに比較結果で選ぶ書き方にしてベクトル化しやすくする.
+
+#define KX0 20.0f
+#define KX1 980.0f
+#define KY0 20.0f
+#define KY1 780.0f
+#define KR 8.0f
+
+typedef struct {
+  float *x, *y, *vx, *vy;
+} FloatBalls;
+
+typedef struct {
+  Fixed *x, *y, *vx, *vy;
+} FixedBalls;
+
+static void StepFloat(FloatBalls b, int n, float step) {
+  for (int i = 0; i < n; i++) {
+    float x = b.x[i] + b.vx[i] * step;
+    float y = b.y[i] + b.vy[i] * step;
+    bool hit_x = x < KX0 + KR || x > KX1 - KR;
+    bool hit_y = y < KY0 + KR || y > KY1 - KR;
+    b.vx[i] = hit_x ? -b.vx[i] : b.vx[i];
+    b.vy[i] = hit_y ? -b.vy[i] : b.vy[i];
+    x = x < KX0 + KR ? KX0 + KR : (x > KX1 - KR ? KX1 - KR : x);
+    y = y < KY0 + KR ? KY0 + KR : (y > KY1 - KR ? KY1 - KR : y);
+    b.x[i] = x;
+    b.y[i] = y;
+  }
+}
+
+static void StepFixed(FixedBalls b, int n, Fixed step) {
+  const Fixed lo_x = FIXED_CONST(KX0 + KR), hi_x = FIXED_CONST(KX1 - KR);
+  const Fixed lo_y = FIXED_CONST(KY0 + KR), hi_y = FIXED_CONST(KY1 - KR);
+  for (int i = 0; i < n; i++) {
+    Fixed x = b.x[i] + FixedMul(b.vx[i], step);
+    Fixed y = b.y[i] + FixedMul(b.vy[i], step);
+    bool hit_x = x < lo_x || x > hi_x;
+    bool hit_y = y < lo_y || y > hi_y;
+    b.vx[i] = hit_x ? -b.vx[i] : b.vx[i];
+    b.vy[i] = hit_y ? -b.vy[i] : b.vy[i];
+    x = x < lo_x ? lo_x : (x > hi_x ? hi_x : x);
+    y = y < lo_y ? lo_y : (y > hi_y ? hi_y : y);
+    b.x[i] = x;
+    b.y[i] = y;
+  }
+}
+
+static void RunKernel(int n, int iters) {
+  FloatBalls fb = {malloc(sizeof(float) * (size_t)n),
+                   malloc(sizeof(float) * (size_t)n),
+                   malloc(sizeof(float) * (size_t)n),
+                   malloc(sizeof(float) * (size_t)n)};
+  FixedBalls xb = {malloc(sizeof(Fixed) * (size_t)n),
+                   malloc(sizeof(Fixed) * (size_t)n),
+                   malloc(sizeof(Fixed) * (size_t)n),
+                   malloc(sizeof(Fixed) * (size_t)n)};
+  if (!fb.x || !fb.y || !fb.vx || !fb.vy || !xb.x || !xb.y || !xb.vx ||
+      !xb.vy) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  uint32_t rng = 0x2545f491u;
+  for (int i = 0; i < n; i++) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    float ang = (float)(rng % 6283u) / 1000.0f;
+    fb.x[i] = KX0 + KR + (float)(rng % 900u);
+    fb.y[i] = KY0 + KR + (float)((rng >> 10) % 700u);
+    xb.x[i] = FixedFromFloat(fb.x[i]);
+    xb.y[i] = FixedFromFloat(fb.y[i]);
+    xb.vx[i] = FixedCos(FixedFromFloat(ang));
+    xb.vy[i] = FixedSin(FixedFromFloat(ang));
+    fb.vx[i] = FixedToFloat(xb.vx[i]);
+    fb.vy[i] = FixedToFloat(xb.vy[i]);
+  }
+  // 1 フレームで BALL_BASE_SPEED / 60 px 進む
+  const float step = BALL_BASE_SPEED / 60.0f;
+
+  double t0 = NowSec();
+  for (int it = 0; it < iters; it++)
+    StepFloat(fb, n, step);
+  double float_sec = NowSec() - t0;
+
+  t0 = NowSec();
+  for (int it = 0; it < iters; it++)
+    StepFixed(xb, n, FixedFromFloat(step));
+  double fixed_sec = NowSec() - t0;
+
+  // 同じ初期値から進めたときのずれ (固定小数点の丸め誤差の目安)
+  double drift = 0.0;
+  for (int i = 0; i < n; i++) {
+    double dx = (double)fb.x[i] - FixedToFloat(xb.x[i]);
+    double dy = (double)fb.y[i] - FixedToFloat(xb.y[i]);
+    drift += dx * dx + dy * dy;
+  }
+  double updates = (double)n * iters;
+  printf("kernel: %d balls x %d steps\n", n, iters);
+  printf("  float   %8.2f ns/ball-step\n", float_sec * 1e9 / updates);
+  printf("  Q16.16  %8.2f ns/ball-step  (%.2fx float)\n",
+         fixed_sec * 1e9 / updates, float_sec / fixed_sec);
+  printf("  rms position drift after %d steps: %.4f px\n", iters,
+         n ? sqrt(drift / n) : 0.0);
+
+  free(fb.x);
+  free(fb.y);
+  free(fb.vx);
+  free(fb.vy);
+  free(xb.x);
+  free(xb.y);
+  free(xb.vx);
+  free(xb.vy);
+}
+
+int main(int argc, char **argv) {
+  int worlds = 64;
+  int frames = 3600;
+  int balls = 1 << 16;
+  int iters = 1000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--worlds") == 0 && i + 1 < argc)
+      worlds = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc)
+      balls = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc)
+      iters = atoi(argv[++i]);
+    else {
+      fprintf(stderr,
+              "usage: %s [--worlds N] [--frames N] [--balls N] [--iters N]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (worlds < 1 || frames < 1 || balls < 1 || iters < 1) {
+    fprintf(stderr, "all counts must be positive\n");
+    return 2;
+  }
+  RunSim(worlds, frames);
+  RunKernel(balls, iters);
+  return 0;
+}
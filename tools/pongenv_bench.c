@@ -0,0 +1,112 @@
+// libpongenv.so の 1 秒あたりの環境ステップ数を測る.
+// ボットはボールの x を追いかけ, 発射は常に押しておく.
+//
+//   ./tools/pongenv_bench [--envs N] [--threads N] [--steps N] [--level N]
+#define _POSIX_C_SOURCE 200809L
+
+#include "../pongenv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// world.h と同じ値 (公開 ABI だけを使うため複製している)
+#define ACT_LEFT 0x1
+#define ACT_RIGHT 0x2
+#define ACT_LAUNCH 0x4
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void ChooseActions(const float *obs, uint8_t *actions, int n) {
+  for (int i = 0; i < n; i++) {
+    const float *o = obs + (size_t)i * PONGENV_OBS_SIZE;
+    float target = o[0];
+    // 下向きに動いている最初のボールを追う
+    for (int b = 0; b < 4; b++) {
+      const float *ball = o + PONGENV_OBS_BALLS_AT + b * PONGENV_OBS_BALL;
+      if (ball[0] > 0.0f && ball[5] > 0.0f) {
+        target = ball[2];
+        break;
+      }
+    }
+    uint8_t a = ACT_LAUNCH;
+    if (target < o[0] - 0.01f)
+      a |= ACT_LEFT;
+    else if (target > o[0] + 0.01f)
+      a |= ACT_RIGHT;
+    actions[i] = a;
+  }
+}
+
+int main(int argc, char **argv) {
+  int envs = 1024;
+  int threads = 0;
+  int steps = 2000;
+  int level = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--envs") == 0 && i + 1 < argc)
+      envs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+      steps = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc)
+      level = atoi(argv[++i]);
+    else {
+      fprintf(stderr,
+              "usage: %s [--envs N] [--threads N] [--steps N] [--level N]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  PongEnv *env = PongEnvCreate(envs, level, threads, 60 * 60 * 5);
+  if (env == NULL) {
+    fprintf(stderr, "PongEnvCreate failed\n");
+    return 1;
+  }
+  float *obs = malloc(sizeof(float) * (size_t)envs * PONGENV_OBS_SIZE);
+  float *rewards = malloc(sizeof(float) * (size_t)envs);
+  uint8_t *dones = malloc((size_t)envs);
+  uint8_t *actions = malloc((size_t)envs);
+  if (obs == NULL || rewards == NULL || dones == NULL || actions == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  PongEnvReset(env, 1, obs);
+  double reward_sum = 0.0;
+  long episodes = 0;
+  double act_time = 0.0;
+  double t0 = NowSec();
+  for (int s = 0; s < steps; s++) {
+    double a0 = NowSec();
+    ChooseActions(obs, actions, envs);
+    act_time += NowSec() - a0;
+    PongEnvStep(env, actions, obs, rewards, dones);
+    for (int i = 0; i < envs; i++) {
+      reward_sum += rewards[i];
+      episodes += dones[i] != PONGENV_DONE_NONE;
+    }
+  }
+  double elapsed = NowSec() - t0 - act_time;
+
+  double total = (double)envs * steps;
+  printf("envs %d, steps %d, level %d\n", envs, steps, level);
+  printf("%.0f env steps in %.3f s: %.2f M steps/s (%.1f ns/step)\n", total,
+         elapsed, total / elapsed * 1e-6, elapsed * 1e9 / total);
+  printf("episodes finished %ld, mean reward per step %.3f\n", episodes,
+         reward_sum / total);
+
+  free(actions);
+  free(dones);
+  free(rewards);
+  free(obs);
+  PongEnvDestroy(env);
+  return 0;
+}
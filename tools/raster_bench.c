@@ -0,0 +1,193 @@
+// libpongenv.so のソフトウェアラスタライザの速度と精度を測る.
+//   速度: 途中まで進めた N 個の環境を 84x84 グレー / 84x84 RGB / 160x128 RGB
+//         で繰り返し描き, 1 秒あたりのフレーム数を出す.
+//   一貫性: 1000x800 (画面と同じ大きさ) で描いたものを 5x5 の面積平均で
+//           縮小した絵と, 200x160 で直接描いた絵の差を出す. どちらも
+//           このラスタライザで描いたもので, raylib の画面とは比べていない.
+//
+//   ./tools/raster_bench [--envs N] [--threads N] [--iters N] [--ppm PREFIX]
+#define _POSIX_C_SOURCE 200809L
+
+#include "../pongenv.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WARMUP_STEPS 240
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// pongenv_bench と同じくボールを追うボット
+static void ChooseActions(const float *obs, uint8_t *actions, int n) {
+  for (int i = 0; i < n; i++) {
+    const float *o = obs + (size_t)i * PONGENV_OBS_SIZE;
+    float target = o[0];
+    for (int b = 0; b < 4; b++) {
+      const float *ball = o + PONGENV_OBS_BALLS_AT + b * PONGENV_OBS_BALL;
+      if (ball[0] > 0.0f && ball[5] > 0.0f) {
+        target = ball[2];
+        break;
+      }
+    }
+    uint8_t a = 0x4;
+    if (target < o[0] - 0.01f)
+      a |= 0x1;
+    else if (target > o[0] + 0.01f)
+      a |= 0x2;
+    actions[i] = a;
+  }
+}
+
+static PongEnv *WarmEnv(int envs, int threads) {
+  PongEnv *env = PongEnvCreate(envs, 1, threads, 0);
+  if (env == NULL)
+    return NULL;
+  float *obs = malloc(sizeof(float) * (size_t)envs * PONGENV_OBS_SIZE);
+  float *rewards = malloc(sizeof(float) * (size_t)envs);
+  uint8_t *dones = malloc((size_t)envs);
+  uint8_t *actions = malloc((size_t)envs);
+  PongEnvReset(env, 7, obs);
+  for (int s = 0; s < WARMUP_STEPS; s++) {
+    ChooseActions(obs, actions, envs);
+    PongEnvStep(env, actions, obs, rewards, dones);
+  }
+  free(actions);
+  free(dones);
+  free(rewards);
+  free(obs);
+  return env;
+}
+
+static void WritePnm(const char *path, const uint8_t *pixels, int w, int h,
+                     int channels) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return;
+  }
+  fprintf(f, "P%d\n%d %d\n255\n", channels == 1 ? 5 : 6, w, h);
+  fwrite(pixels, 1, (size_t)w * h * channels, f);
+  fclose(f);
+}
+
+static void Bench(PongEnv *env, int envs, int iters, int w, int h,
+                  int channels, const char *ppm_prefix) {
+  size_t frame = (size_t)w * h * channels;
+  uint8_t *pixels = malloc(frame * (size_t)envs);
+  if (pixels == NULL || PongEnvRender(env, pixels, w, h, channels) != 0) {
+    fprintf(stderr, "render %dx%dx%d failed\n", w, h, channels);
+    free(pixels);
+    return;
+  }
+  double t0 = NowSec();
+  for (int it = 0; it < iters; it++)
+    PongEnvRender(env, pixels, w, h, channels);
+  double elapsed = NowSec() - t0;
+  double frames = (double)envs * iters;
+  printf("%4dx%-4d %-4s %10.0f frames/s  %6.2f us/frame\n", w, h,
+         channels == 1 ? "gray" : "rgb", frames / elapsed,
+         elapsed * 1e6 / frames);
+  if (ppm_prefix != NULL) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s_%dx%d_%s.%s", ppm_prefix, w, h,
+             channels == 1 ? "gray" : "rgb", channels == 1 ? "pgm" : "ppm");
+    WritePnm(path, pixels, w, h, channels);
+  }
+  free(pixels);
+}
+
+// 画面サイズで描いたものを縮小した絵と, 直接描いた絵の差 (解像度を変えても
+// 同じ絵になっているかを見るだけで, raylib の描画と一致するかは分からない)
+static void Check(int threads) {
+  const int envs = 4;
+  const int big_w = 1000, big_h = 800, small_w = 200, small_h = 160;
+  const int k = big_w / small_w;
+  PongEnv *env = WarmEnv(envs, threads);
+  uint8_t *big = malloc((size_t)big_w * big_h * 3 * envs);
+  uint8_t *small = malloc((size_t)small_w * small_h * 3 * envs);
+  if (env == NULL || big == NULL || small == NULL) {
+    fprintf(stderr, "check: setup failed\n");
+    return;
+  }
+  PongEnvRender(env, big, big_w, big_h, 3);
+  PongEnvRender(env, small, small_w, small_h, 3);
+
+  double sum = 0.0;
+  int worst = 0;
+  long count = 0;
+  for (int e = 0; e < envs; e++) {
+    const uint8_t *b = big + (size_t)e * big_w * big_h * 3;
+    const uint8_t *s = small + (size_t)e * small_w * small_h * 3;
+    for (int y = 0; y < small_h; y++) {
+      for (int x = 0; x < small_w; x++) {
+        for (int c = 0; c < 3; c++) {
+          int acc = 0;
+          for (int dy = 0; dy < k; dy++) {
+            for (int dx = 0; dx < k; dx++)
+              acc += b[(((size_t)(y * k + dy) * big_w) + x * k + dx) * 3 + c];
+          }
+          int avg = (acc + k * k / 2) / (k * k);
+          int diff = abs(avg - s[((size_t)y * small_w + x) * 3 + c]);
+          sum += diff;
+          if (diff > worst)
+            worst = diff;
+          count++;
+        }
+      }
+    }
+  }
+  printf("self-consistency: direct %dx%d vs own %dx%d box-downscaled: mean "
+         "abs diff %.3f, max %d (0-255)\n",
+         small_w, small_h, big_w, big_h, sum / count, worst);
+  free(small);
+  free(big);
+  PongEnvDestroy(env);
+}
+
+int main(int argc, char **argv) {
+  int envs = 1024;
+  int threads = 0;
+  int iters = 50;
+  const char *ppm_prefix = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--envs") == 0 && i + 1 < argc)
+      envs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc)
+      iters = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc)
+      ppm_prefix = argv[++i];
+    else {
+      fprintf(stderr,
+              "usage: %s [--envs N] [--threads N] [--iters N] "
+              "[--ppm PREFIX]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (envs < 1 || iters < 1) {
+    fprintf(stderr, "--envs and --iters must be positive\n");
+    return 2;
+  }
+
+  PongEnv *env = WarmEnv(envs, threads);
+  if (env == NULL) {
+    fprintf(stderr, "PongEnvCreate failed\n");
+    return 1;
+  }
+  printf("envs %d, iters %d\n", envs, iters);
+  Bench(env, envs, iters, 84, 84, 1, ppm_prefix);
+  Bench(env, envs, iters, 84, 84, 3, ppm_prefix);
+  Bench(env, envs, iters, 160, 128, 3, ppm_prefix);
+  PongEnvDestroy(env);
+  Check(threads);
+  return 0;
+}
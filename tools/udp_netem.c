@@ -0,0 +1,169 @@
+// ループバック上の対戦テスト用に, UDP を中継しながら遅延・ゆらぎ・ロスを加える.
+//
+//   ./tools/udp_netem LISTEN_PORT TARGET_HOST:PORT [--delay MS] [--jitter MS]
+//                     [--loss PERCENT]
+//
+// LISTEN_PORT に届いたパケットを TARGET へ,
+// TARGET からの返事を最後の送り主へ返す.
+// どちらの向きにも同じ遅延とロスが掛かる (RTT はおよそ delay の2倍になる).
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define QUEUE_SIZE 4096
+#define PACKET_MAX 1500
+
+typedef struct {
+  uint64_t deliver_us;
+  int to_target;
+  int len;
+  uint8_t data[PACKET_MAX];
+  bool used;
+} Pending;
+
+static volatile sig_atomic_t running = 1;
+
+static void OnSignal(int sig) {
+  (void)sig;
+  running = 0;
+}
+
+static uint64_t NowMicros(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static int OpenSocket(int port) {
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons((uint16_t)port);
+  if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("udp_netem");
+    exit(1);
+  }
+  return sock;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr,
+            "usage: %s LISTEN_PORT TARGET_HOST:PORT [--delay MS] "
+            "[--jitter MS] [--loss PERCENT]\n",
+            argv[0]);
+    return 2;
+  }
+  int listen_port = atoi(argv[1]);
+  char target_host[256];
+  const char *colon = strrchr(argv[2], ':');
+  if (colon == NULL || (size_t)(colon - argv[2]) >= sizeof(target_host)) {
+    fprintf(stderr, "bad target '%s'\n", argv[2]);
+    return 2;
+  }
+  memcpy(target_host, argv[2], (size_t)(colon - argv[2]));
+  target_host[colon - argv[2]] = '\0';
+  float delay_ms = 0.0f;
+  float jitter_ms = 0.0f;
+  float loss_pct = 0.0f;
+  for (int i = 3; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--delay") == 0)
+      delay_ms = (float)atof(argv[i + 1]);
+    else if (strcmp(argv[i], "--jitter") == 0)
+      jitter_ms = (float)atof(argv[i + 1]);
+    else if (strcmp(argv[i], "--loss") == 0)
+      loss_pct = (float)atof(argv[i + 1]);
+  }
+
+  struct sockaddr_in target = {0};
+  target.sin_family = AF_INET;
+  target.sin_port = htons((uint16_t)atoi(colon + 1));
+  if (inet_pton(AF_INET, target_host, &target.sin_addr) != 1) {
+    fprintf(stderr, "target must be an IPv4 address\n");
+    return 2;
+  }
+  struct sockaddr_in client = {0};
+  bool have_client = false;
+
+  int front = OpenSocket(listen_port);
+  int back = OpenSocket(0);
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+  srand((unsigned int)time(NULL));
+
+  static Pending queue[QUEUE_SIZE];
+  unsigned long forwarded = 0;
+  unsigned long dropped = 0;
+  printf("udp_netem: :%d <-> %s delay %.1fms jitter %.1fms loss %.1f%%\n",
+         listen_port, argv[2], delay_ms, jitter_ms, loss_pct);
+  fflush(stdout);
+
+  while (running) {
+    struct pollfd fds[2] = {{front, POLLIN, 0}, {back, POLLIN, 0}};
+    poll(fds, 2, 1);
+    uint64_t now = NowMicros();
+    for (int f = 0; f < 2; f++) {
+      if (!(fds[f].revents & POLLIN))
+        continue;
+      uint8_t buf[PACKET_MAX];
+      struct sockaddr_in from;
+      socklen_t from_len = sizeof(from);
+      ssize_t n = recvfrom(fds[f].fd, buf, sizeof(buf), 0,
+                           (struct sockaddr *)&from, &from_len);
+      if (n <= 0)
+        continue;
+      if (f == 0) {
+        client = from;
+        have_client = true;
+      }
+      if ((float)rand() / (float)RAND_MAX * 100.0f < loss_pct) {
+        dropped++;
+        continue;
+      }
+      float jitter =
+          ((float)rand() / (float)RAND_MAX * 2.0f - 1.0f) * jitter_ms;
+      float total_ms = delay_ms + jitter;
+      if (total_ms < 0.0f)
+        total_ms = 0.0f;
+      for (int q = 0; q < QUEUE_SIZE; q++) {
+        if (!queue[q].used) {
+          queue[q].used = true;
+          queue[q].deliver_us = now + (uint64_t)(total_ms * 1000.0f);
+          queue[q].to_target = (f == 0);
+          queue[q].len = (int)n;
+          memcpy(queue[q].data, buf, (size_t)n);
+          break;
+        }
+      }
+    }
+    for (int q = 0; q < QUEUE_SIZE; q++) {
+      if (!queue[q].used || queue[q].deliver_us > now)
+        continue;
+      queue[q].used = false;
+      if (queue[q].to_target) {
+        sendto(back, queue[q].data, (size_t)queue[q].len, 0,
+               (struct sockaddr *)&target, sizeof(target));
+      } else if (have_client) {
+        sendto(front, queue[q].data, (size_t)queue[q].len, 0,
+               (struct sockaddr *)&client, sizeof(client));
+      }
+      forwarded++;
+    }
+  }
+  printf("udp_netem: forwarded %lu, dropped %lu\n", forwarded, dropped);
+  close(front);
+  close(back);
+  return 0;
+}
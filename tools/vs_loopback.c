@@ -0,0 +1,205 @@
+// 対戦モードを1台のマシン上で通しで確認するためのツール.
+// ホストと参加側の2つのピアをスレッドで動かし, 60Hz で実際に UDP 通信しながら
+// ボットの入力で対戦を進め, 最後に両者のハッシュが一致するかを確かめる.
+//
+//   ./tools/vs_loopback                       直結 (127.0.0.1:7000)
+//   ./tools/udp_netem 7001 127.0.0.1:7000 --delay 40 --loss 5 &
+//   ./tools/vs_loopback --connect 127.0.0.1:7001   遅延とロスを入れて確認
+#define _POSIX_C_SOURCE 200809L
+
+#include "../lockstep.h"
+#include "../versus.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LINGER_TICKS 60
+
+typedef struct {
+  bool host;
+  const char *connect_host;
+  int port;
+  int connect_port;
+  int frames;
+  Lockstep ls;
+  Versus vs;
+  uint64_t final_hash;
+  bool ok;
+} Peer;
+
+static void AddNanos(struct timespec *ts, long ns) {
+  ts->tv_nsec += ns;
+  while (ts->tv_nsec >= 1000000000L) {
+    ts->tv_nsec -= 1000000000L;
+    ts->tv_sec++;
+  }
+}
+
+// 自分のボールを追いかけるだけの単純なボット
+static uint8_t BotInput(const World *world, uint32_t *rng) {
+  *rng = *rng * 1664525u + 1013904223u;
+  uint8_t input = 0;
+  float target = RealToFloat(world->balls[0].pos.x);
+  for (int i = 0; i < MAX_BALLS; i++) {
+    if (world->balls[i].active && !world->balls[i].stuck) {
+      target = RealToFloat(world->balls[i].pos.x);
+      break;
+    }
+  }
+  target += (float)((int)(*rng >> 24) - 128) * 0.4f;
+  float center = RealToFloat(world->paddle.x) +
+                 RealToFloat(world->paddle.width) * 0.5f;
+  if (target < center - 8.0f)
+    input |= INPUT_LEFT;
+  if (target > center + 8.0f)
+    input |= INPUT_RIGHT;
+  if ((*rng >> 8) % 30 == 0)
+    input |= INPUT_LAUNCH;
+  return input;
+}
+
+static void *RunPeer(void *arg) {
+  Peer *peer = arg;
+  Lockstep *ls = &peer->ls;
+  bool opened = peer->host
+                    ? LockstepHost(ls, (uint16_t)peer->port, 20240601u)
+                    : LockstepJoin(ls, peer->connect_host,
+                                   (uint16_t)peer->connect_port);
+  if (!opened)
+    return NULL;
+
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  uint32_t rng = peer->host ? 1u : 2u;
+  bool started = false;
+  int linger = 0;
+  int waited = 0;
+  while (linger < LINGER_TICKS) {
+    LockstepPoll(ls);
+    if (ls->status == LOCKSTEP_DISCONNECTED)
+      break;
+    if (ls->status == LOCKSTEP_RUNNING) {
+      if (!started) {
+        VersusInit(&peer->vs, ls->seed);
+        started = true;
+      }
+      if (ls->sim_frame < peer->frames) {
+        LockstepAddLocalInput(ls,
+                              BotInput(&peer->vs.fields[ls->player], &rng));
+      } else {
+        linger++;
+      }
+      LockstepSend(ls);
+      uint8_t in0, in1;
+      if (ls->sim_frame < peer->frames && LockstepNextFrame(ls, &in0, &in1)) {
+        VersusStep(&peer->vs, in0, in1);
+        if (ls->sim_frame % LOCKSTEP_HASH_INTERVAL == 0)
+          LockstepReportHash(ls, ls->sim_frame, VersusHash(&peer->vs));
+      }
+    } else if (++waited > 60 * 10) {
+      fprintf(stderr, "peer %d: no connection after 10s\n", ls->player);
+      break;
+    }
+    AddNanos(&next, 1000000000L / VERSUS_HZ);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+  peer->final_hash = VersusHash(&peer->vs);
+  peer->ok = started && ls->sim_frame >= peer->frames;
+  LockstepClose(ls);
+  return NULL;
+}
+
+static void PrintPeer(const Peer *peer) {
+  const Lockstep *ls = &peer->ls;
+  double per_packet =
+      ls->packets_sent ? (double)ls->bytes_sent / (double)ls->packets_sent : 0;
+  double per_frame =
+      ls->sim_frame ? (double)ls->bytes_sent / (double)ls->sim_frame : 0;
+  printf("peer %d: frames %d stalls %llu rtt %.2fms (+-%.2f) delay %d, "
+         "added input latency %.1fms (avg %.1fms)\n",
+         ls->player, ls->sim_frame, (unsigned long long)ls->stall_ticks,
+         ls->srtt_ms, ls->rttvar_ms, ls->delay, LockstepAddedLatencyMs(ls),
+         LockstepAvgAddedLatencyMs(ls));
+  printf("        packets %llu sent / %llu recv, %.1f B/packet, %.1f B/frame, "
+         "hashes checked %d\n",
+         (unsigned long long)ls->packets_sent,
+         (unsigned long long)ls->packets_recv, per_packet, per_frame,
+         ls->hashes_checked);
+  printf("        inputs %llu frames (with redundancy) in %llu B "
+         "(%.1fx smaller than 1 B/frame)\n",
+         (unsigned long long)ls->inputs_sent,
+         (unsigned long long)ls->input_bytes,
+         ls->input_bytes ? (double)ls->inputs_sent / (double)ls->input_bytes
+                         : 0.0);
+  if (ls->desync)
+    printf("        DESYNC at frame %d\n", ls->desync_frame);
+}
+
+static bool ParseHostPort(const char *arg, char *host, size_t host_size,
+                          int *port) {
+  const char *colon = strrchr(arg, ':');
+  if (colon == NULL || (size_t)(colon - arg) >= host_size)
+    return false;
+  memcpy(host, arg, (size_t)(colon - arg));
+  host[colon - arg] = '\0';
+  *port = atoi(colon + 1);
+  return *port > 0;
+}
+
+int main(int argc, char **argv) {
+  static Peer peers[2];
+  static char connect_host[256] = "127.0.0.1";
+  int port = 7000;
+  int connect_port = 0;
+  int frames = 600;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+      if (!ParseHostPort(argv[++i], connect_host, sizeof(connect_host),
+                         &connect_port)) {
+        fprintf(stderr, "bad address '%s'\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else {
+      fprintf(stderr,
+              "usage: %s [--port P] [--connect HOST:PORT] [--frames N]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (connect_port == 0)
+    connect_port = port;
+
+  for (int p = 0; p < 2; p++) {
+    peers[p].host = (p == 0);
+    peers[p].port = port;
+    peers[p].connect_host = connect_host;
+    peers[p].connect_port = connect_port;
+    peers[p].frames = frames;
+  }
+  pthread_t threads[2];
+  for (int p = 0; p < 2; p++)
+    pthread_create(&threads[p], NULL, RunPeer, &peers[p]);
+  for (int p = 0; p < 2; p++)
+    pthread_join(threads[p], NULL);
+
+  for (int p = 0; p < 2; p++)
+    PrintPeer(&peers[p]);
+  const Versus *vs = &peers[0].vs;
+  printf("score %d - %d, garbage rows sent %d - %d, winner %d\n",
+         vs->fields[0].score, vs->fields[1].score, vs->garbage_sent[0],
+         vs->garbage_sent[1], vs->winner);
+
+  bool ok = peers[0].ok && peers[1].ok && !peers[0].ls.desync &&
+            !peers[1].ls.desync && peers[0].final_hash == peers[1].final_hash;
+  printf("%s: final hash %016llx / %016llx\n", ok ? "OK" : "FAIL",
+         (unsigned long long)peers[0].final_hash,
+         (unsigned long long)peers[1].final_hash);
+  return ok ? 0 : 1;
+}
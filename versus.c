@@ -0,0 +1,60 @@
+#include "versus.h"
+
+void VersusInit(Versus *vs, uint32_t seed) {
+  WorldInit(&vs->fields[0], LEVEL_VERSUS, seed);
+  WorldInit(&vs->fields[1], LEVEL_VERSUS, seed);
+  for (int p = 0; p < 2; p++) {
+    vs->garbage_meter[p] = 0;
+    vs->garbage_sent[p] = 0;
+  }
+  vs->winner = -1;
+  vs->frame = 0;
+}
+
+void VersusStep(Versus *vs, uint8_t input0, uint8_t input1) {
+  if (vs->winner >= 0)
+    return;
+
+  WorldStep(&vs->fields[0], input0 & INPUT_MASK, VERSUS_DT);
+  WorldStep(&vs->fields[1], input1 & INPUT_MASK, VERSUS_DT);
+
+  // 両者の破壊数を先に集計してから送るので, 処理順で有利不利が出ない
+  int rows[2];
+  for (int p = 0; p < 2; p++) {
+    vs->garbage_meter[p] += vs->fields[p].destroyed;
+    rows[p] = vs->garbage_meter[p] / VERSUS_GARBAGE_BRICKS;
+    vs->garbage_meter[p] %= VERSUS_GARBAGE_BRICKS;
+  }
+  for (int p = 0; p < 2; p++) {
+    if (rows[p] > 0) {
+      WorldAddGarbage(&vs->fields[1 - p], rows[p]);
+      vs->garbage_sent[p] += rows[p];
+    }
+  }
+  vs->frame++;
+
+  bool lost[2];
+  for (int p = 0; p < 2; p++) {
+    lost[p] = vs->fields[p].status == WORLD_OVER;
+    if (vs->fields[p].status == WORLD_CLEAR)
+      lost[1 - p] = true;
+  }
+  if (vs->fields[0].status == WORLD_CLEAR &&
+      vs->fields[1].status == WORLD_CLEAR) {
+    vs->winner = 2;
+  } else if (lost[0] && lost[1]) {
+    vs->winner = 2;
+  } else if (lost[0]) {
+    vs->winner = 1;
+  } else if (lost[1]) {
+    vs->winner = 0;
+  }
+}
+
+uint64_t VersusHash(const Versus *vs) {
+  uint64_t hash = WorldHash(&vs->fields[0], 0);
+  hash = WorldHash(&vs->fields[1], hash);
+  hash ^= (uint64_t)vs->frame << 32 | (uint32_t)vs->garbage_meter[0] << 8 |
+          (uint32_t)vs->garbage_meter[1];
+  return hash;
+}
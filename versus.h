@@ -0,0 +1,25 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include "world.h"
+
+// 対戦は固定 60Hz で両者のフィールドを同じ順序で進める (ロックステップ)
+#define VERSUS_HZ 60
+#define VERSUS_DT (1.0f / VERSUS_HZ)
+// この数だけブロックを壊すと相手に1段送る
+#define VERSUS_GARBAGE_BRICKS 4
+
+typedef struct {
+  World fields[2];
+  int garbage_meter[2];
+  int garbage_sent[2];
+  // -1: 対戦中, 0/1: 勝者, 2: 引き分け
+  int winner;
+  uint32_t frame;
+} Versus;
+
+void VersusInit(Versus *vs, uint32_t seed);
+void VersusStep(Versus *vs, uint8_t input0, uint8_t input1);
+uint64_t VersusHash(const Versus *vs);
+
+#endif
@@ -0,0 +1,946 @@
+#include "world.h"
+
+#include <string.h>
+
+// 動くブロックの角速度 (rad/s)
+#define SLIDE_RATE 1.2f
+#define ORBIT_RATE 2.0f
+#define ROTATE_RATE 0.8f
+// 上の3つの角速度がすべて整数周するまでの時間. 経過時間はこれで折り返す
+// (固定小数点の範囲を超えないように)
+#define MOTION_PERIOD (10.0f * PI)
+// BVH の葉に付ける余白. 数フレーム分の移動なら作り直さずに済む
+#define BRICK_BVH_MARGIN 4.0f
+// 当たった時刻を見積もるときの, 跳ね返す軸の速度成分の下限 (割り算用)
+#define MIN_AXIS_VEL (1.0f / 64.0f)
+
+static Real ClampReal(Real v, Real min, Real max) {
+  if (v < min)
+    return min;
+  if (v > max)
+    return max;
+  return v;
+}
+
+static Vec2 NormalizeSafe(Vec2 v) {
+  Real len = RealSqrt(RealMul(v.x, v.x) + RealMul(v.y, v.y));
+  if (len <= REAL(0.0001f)) {
+    return (Vec2){REAL(0.0f), REAL(-1.0f)};
+  }
+  return (Vec2){RealDiv(v.x, len), RealDiv(v.y, len)};
+}
+
+static Real LevelSpeedMult(int level) {
+  if (level <= 1)
+    return REAL(0.85f);
+  if (level == 2)
+    return REAL(0.95f);
+  return REAL(1.05f);
+}
+
+static Real SpeedItemMult(int speed_state) {
+  if (speed_state < 0)
+    return REAL(0.7f);
+  if (speed_state > 0)
+    return REAL(1.35f);
+  return REAL(1.0f);
+}
+
+// xorshift32. GetRandomValue と違い状態をワールドごとに持つので再現できる
+static int RandomRange(uint32_t *state, int min, int max) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return min + (int)(x % (uint32_t)(max - min + 1));
+}
+
+static bool CircleHitsRect(Vec2 center, Real radius, Rect rec) {
+  Real nearest_x = ClampReal(center.x, rec.x, rec.x + rec.width);
+  Real nearest_y = ClampReal(center.y, rec.y, rec.y + rec.height);
+  Real dx = center.x - nearest_x;
+  Real dy = center.y - nearest_y;
+  // 先に軸ごとに判定しておくと, 固定小数点で2乗があふれない
+  if (RealAbs(dx) > radius || RealAbs(dy) > radius)
+    return false;
+  return RealMul(dx, dx) + RealMul(dy, dy) <= RealMul(radius, radius);
+}
+
+Rgba PowerupColor(PowerType type) {
+  if (type == POWER_MULTIBALL)
+    return (Rgba){100, 181, 246, 255};
+  if (type == POWER_EXTEND)
+    return (Rgba){129, 199, 132, 255};
+  if (type == POWER_SLOW)
+    return (Rgba){255, 213, 79, 255};
+  if (type == POWER_LIFE)
+    return (Rgba){244, 143, 177, 255};
+  if (type == POWER_FAST)
+    return (Rgba){255, 167, 38, 255};
+  return (Rgba){239, 83, 80, 255};
+}
+
+char PowerupLabel(PowerType type) {
+  if (type == POWER_MULTIBALL)
+    return 'M';
+  if (type == POWER_SLOW)
+    return 'S';
+  if (type == POWER_LIFE)
+    return 'L';
+  if (type == POWER_FAST)
+    return 'F';
+  if (type == POWER_DEATH)
+    return 'X';
+  return 'E';
+}
+
+Rgba BrickColor(const Brick *brick) {
+  if (brick->solid)
+    return (Rgba){90, 90, 110, 255};
+  if (brick->power_brick)
+    return PowerupColor(brick->power_type);
+  return (Rgba){245, 245, 245, 255};
+}
+
+static void ResetBalls(World *world) {
+  for (int i = 0; i < MAX_BALLS; i++) {
+    world->balls[i].active = false;
+    world->balls[i].stuck = false;
+    world->balls[i].radius = REAL(BALL_RADIUS);
+  }
+  world->balls[0].active = true;
+  world->balls[0].stuck = true;
+  world->balls[0].pos =
+      (Vec2){world->paddle.x + RealMul(world->paddle.width, REAL(0.5f)),
+             world->paddle.y - REAL(BALL_RADIUS) - REAL(2.0f)};
+  world->balls[0].vel = (Vec2){REAL(0.0f), REAL(-1.0f)};
+}
+
+static void ResetPaddle(World *world) {
+  world->paddle_target_w = REAL(BASE_PADDLE_W);
+  world->paddle.width = REAL(BASE_PADDLE_W);
+  world->paddle.x = REAL(PLAY_X + PLAY_W * 0.5f) -
+                    RealMul(world->paddle.width, REAL(0.5f));
+}
+
+static void LaunchBall(World *world, Ball *ball) {
+  Real angle =
+      RealMul(RealFromInt(RandomRange(&world->rng, 40, 140)), REAL(DEG2RAD));
+  ball->vel = (Vec2){RealCos(angle), -RealSin(angle)};
+  ball->stuck = false;
+}
+
+static void SpawnParticles(World *world, Vec2 pos, Rgba color) {
+  int spawned = 0;
+  for (int i = 0; i < MAX_PARTICLES; i++) {
+    Particle *p = &world->particles[i];
+    if (!p->active) {
+      p->active = true;
+      p->pos = pos;
+      p->life = REAL(0.7f) + RealDiv(RealFromInt(RandomRange(
+                                         &world->fx_rng, 0, 30)),
+                                     REAL(100.0f));
+      Real speed =
+          REAL(80.0f) + RealFromInt(RandomRange(&world->fx_rng, 0, 140));
+      Real ang = RealMul(RealFromInt(RandomRange(&world->fx_rng, 0, 360)),
+                         REAL(DEG2RAD));
+      p->vel = (Vec2){RealMul(RealCos(ang), speed),
+                      RealMul(RealSin(ang), speed)};
+      p->color = color;
+      spawned++;
+      if (spawned >= 14)
+        break;
+    }
+  }
+}
+
+static void SpawnPowerup(World *world, Vec2 pos, PowerType type) {
+  for (int i = 0; i < MAX_POWERUPS; i++) {
+    Powerup *p = &world->powerups[i];
+    if (!p->active) {
+      p->active = true;
+      p->pos = pos;
+      p->vel = (Vec2){REAL(0.0f), REAL(160.0f)};
+      p->radius = REAL(12.0f);
+      p->type = type;
+      return;
+    }
+  }
+}
+
+static void SetBrickType(Brick *brick, int val) {
+  brick->alive = (val > 0);
+  brick->solid = false;
+  brick->power_brick = false;
+  brick->power_type = POWER_MULTIBALL;
+  if (val == 2) {
+    brick->power_brick = true;
+    brick->power_type = POWER_MULTIBALL;
+  } else if (val == 3) {
+    brick->power_brick = true;
+    brick->power_type = POWER_EXTEND;
+  } else if (val == 4) {
+    brick->power_brick = true;
+    brick->power_type = POWER_DEATH;
+  } else if (val == 5) {
+    brick->power_brick = true;
+    brick->power_type = POWER_SLOW;
+  } else if (val == 6) {
+    brick->power_brick = true;
+    brick->power_type = POWER_LIFE;
+  } else if (val == 7) {
+    brick->power_brick = true;
+    brick->power_type = POWER_FAST;
+  } else if (val == 8) {
+    brick->solid = true;
+  }
+  brick->max_hp = 1;
+  brick->hp = brick->max_hp;
+}
+
+static int CountBreakable(const World *world) {
+  int count = 0;
+  for (int i = 0; i < MAX_BRICKS; i++) {
+    if (world->bricks[i].alive && !world->bricks[i].solid)
+      count++;
+  }
+  return count;
+}
+
+static Bvh BrickBvh(World *world) {
+  return (Bvh){world->brick_nodes, world->brick_leaf, &world->brick_bvh};
+}
+
+// 木を使うのはブロックが動き, かつ数が多いときだけ. 止まっている面や
+// 少ない数では番号順に全部調べる方が速い (tools/bvh_bench)
+static bool UseBrickBvh(const World *world) {
+  return world->moving && MAX_BRICKS >= BRICK_BVH_MIN_BRICKS;
+}
+
+static Aabb RectBox(Rect rec) {
+  return (Aabb){RealToFloat(rec.x), RealToFloat(rec.y),
+                RealToFloat(rec.x + rec.width),
+                RealToFloat(rec.y + rec.height)};
+}
+
+static void BrickBoxes(const World *world, Aabb *boxes) {
+  for (int i = 0; i < MAX_BRICKS; i++)
+    boxes[i] = RectBox(world->bricks[i].rect);
+}
+
+static void SetRowMotion(World *world, int row, int c0, int c1,
+                         BrickMotion motion, Real amp) {
+  for (int c = c0; c <= c1; c++) {
+    Brick *brick = &world->bricks[row * BRICK_COLS + c];
+    brick->motion = motion;
+    brick->amp = amp;
+    brick->phase = REAL(0.0f);
+  }
+}
+
+// LEVEL_MOVING: 上2段と最下段は左右に往復, 両脇の塊は円を描き,
+// 中央の 2x2 は隊列のまま回転する
+static void SetupMotion(World *world) {
+  SetRowMotion(world, 0, 0, BRICK_COLS - 1, MOTION_SLIDE, REAL(60.0f));
+  SetRowMotion(world, 1, 0, BRICK_COLS - 1, MOTION_SLIDE, REAL(-50.0f));
+  SetRowMotion(world, 7, 0, BRICK_COLS - 1, MOTION_SLIDE, REAL(60.0f));
+  for (int r = 3; r <= 5; r++) {
+    SetRowMotion(world, r, 1, 2, MOTION_ORBIT, REAL(12.0f));
+    SetRowMotion(world, r, 9, 10, MOTION_ORBIT, REAL(12.0f));
+  }
+  // 左右で逆の位相にして対称に動かす
+  for (int r = 3; r <= 5; r++) {
+    world->bricks[r * BRICK_COLS + 9].phase = REAL(PI);
+    world->bricks[r * BRICK_COLS + 10].phase = REAL(PI);
+  }
+
+  const Rect *a = &world->bricks[3 * BRICK_COLS + 5].home;
+  const Rect *b = &world->bricks[4 * BRICK_COLS + 6].home;
+  Vec2 pivot = {RealMul(a->x + b->x + b->width, REAL(0.5f)),
+                RealMul(a->y + b->y + b->height, REAL(0.5f))};
+  for (int r = 3; r <= 4; r++) {
+    SetRowMotion(world, r, 5, 6, MOTION_ROTATE, REAL(0.0f));
+    world->bricks[r * BRICK_COLS + 5].pivot = pivot;
+    world->bricks[r * BRICK_COLS + 6].pivot = pivot;
+  }
+}
+
+static void MoveBricks(World *world, Real dt) {
+  world->time += dt;
+  if (world->time >= REAL(MOTION_PERIOD))
+    world->time -= REAL(MOTION_PERIOD);
+  Real t = world->time;
+  for (int i = 0; i < MAX_BRICKS; i++) {
+    Brick *brick = &world->bricks[i];
+    Rect home = brick->home;
+    if (brick->motion == MOTION_SLIDE) {
+      Real ang = RealMul(t, REAL(SLIDE_RATE)) + brick->phase;
+      brick->rect.x = home.x + RealMul(brick->amp, RealSin(ang));
+    } else if (brick->motion == MOTION_ORBIT) {
+      Real ang = RealMul(t, REAL(ORBIT_RATE)) + brick->phase;
+      brick->rect.x = home.x + RealMul(brick->amp, RealCos(ang));
+      brick->rect.y = home.y + RealMul(brick->amp, RealSin(ang));
+    } else if (brick->motion == MOTION_ROTATE) {
+      Real ang = RealMul(t, REAL(ROTATE_RATE));
+      Real cs = RealCos(ang);
+      Real sn = RealSin(ang);
+      Real half_w = RealMul(home.width, REAL(0.5f));
+      Real half_h = RealMul(home.height, REAL(0.5f));
+      Real dx = home.x + half_w - brick->pivot.x;
+      Real dy = home.y + half_h - brick->pivot.y;
+      brick->rect.x =
+          brick->pivot.x + RealMul(dx, cs) - RealMul(dy, sn) - half_w;
+      brick->rect.y =
+          brick->pivot.y + RealMul(dx, sn) + RealMul(dy, cs) - half_h;
+    }
+  }
+
+  if (!UseBrickBvh(world))
+    return;
+  Aabb boxes[MAX_BRICKS];
+  int scratch[MAX_BRICKS];
+  BrickBoxes(world, boxes);
+  BvhUpdate(BrickBvh(world), boxes, scratch);
+}
+
+static void InitLevel(World *world, int level) {
+  static const int layouts[5][BRICK_ROWS][BRICK_COLS] = {
+      {
+          {0, 0, 1, 2, 1, 1, 3, 1, 2, 1, 0, 0},
+          {0, 1, 1, 1, 5, 1, 1, 1, 5, 1, 1, 0},
+          {1, 2, 1, 1, 1, 6, 1, 1, 1, 1, 2, 1},
+          {1, 1, 1, 3, 1, 1, 1, 1, 3, 1, 1, 1},
+          {1, 1, 2, 1, 5, 1, 1, 1, 5, 2, 1, 1},
+          {0, 1, 6, 1, 1, 1, 1, 1, 1, 1, 1, 0},
+          {0, 0, 1, 1, 2, 1, 1, 2, 1, 1, 0, 0},
+          {0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0},
+      },
+      {
+          {0, 0, 2, 1, 1, 3, 1, 1, 2, 1, 0, 0},
+          {0, 1, 1, 5, 4, 1, 1, 4, 5, 7, 1, 0},
+          {1, 1, 1, 2, 1, 6, 1, 1, 2, 1, 7, 1},
+          {1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1},
+          {1, 1, 1, 3, 5, 1, 1, 5, 3, 1, 1, 1},
+          {0, 1, 7, 1, 2, 1, 1, 2, 1, 1, 1, 0},
+          {0, 0, 1, 4, 1, 1, 1, 1, 4, 1, 0, 0},
+          {0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0},
+      },
+      {
+          {2, 1, 1, 1, 3, 1, 1, 3, 1, 1, 1, 2},
+          {1, 1, 1, 4, 5, 1, 1, 5, 4, 7, 1, 1},
+          {1, 7, 1, 1, 8, 8, 8, 8, 1, 1, 2, 1},
+          {1, 1, 1, 1, 2, 1, 1, 2, 1, 1, 1, 1},
+          {1, 1, 2, 1, 6, 4, 4, 6, 1, 2, 7, 1},
+          {1, 8, 1, 3, 1, 5, 5, 1, 3, 1, 8, 1},
+          {4, 8, 1, 1, 7, 1, 1, 2, 1, 1, 8, 1},
+          {1, 1, 2, 1, 1, 1, 1, 1, 1, 2, 4, 1},
+      },
+      {
+          {0, 1, 1, 2, 1, 1, 1, 1, 2, 1, 1, 0},
+          {0, 3, 1, 1, 5, 1, 1, 5, 1, 1, 3, 0},
+          {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+          {0, 1, 2, 0, 0, 6, 1, 0, 0, 2, 1, 0},
+          {0, 7, 1, 0, 0, 1, 2, 0, 0, 1, 7, 0},
+          {0, 1, 5, 0, 0, 0, 0, 0, 0, 5, 1, 0},
+          {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+          {0, 1, 1, 1, 3, 1, 1, 3, 1, 1, 1, 0},
+      },
+      {
+          {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+          {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+          {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+          {1, 2, 1, 1, 3, 1, 1, 3, 1, 1, 2, 1},
+          {1, 1, 5, 1, 1, 7, 7, 1, 1, 5, 1, 1},
+          {1, 1, 1, 2, 1, 1, 1, 1, 2, 1, 1, 1},
+          {0, 1, 1, 1, 6, 1, 1, 6, 1, 1, 1, 0},
+          {0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0},
+      },
+  };
+  int idx_level = level < 1 ? 1 : (level > LEVEL_VERSUS ? 3 : level);
+  const int(*layout)[BRICK_COLS] = layouts[idx_level - 1];
+  world->moving = (idx_level == LEVEL_MOVING);
+
+  Real brick_w = RealDiv(RealFromInt(PLAY_W - (BRICK_COLS - 1) * BRICK_GAP),
+                         RealFromInt(BRICK_COLS));
+  Real brick_h = REAL(24.0f);
+  for (int r = 0; r < BRICK_ROWS; r++) {
+    for (int c = 0; c < BRICK_COLS; c++) {
+      int idx = r * BRICK_COLS + c;
+      SetBrickType(&world->bricks[idx], layout[r][c]);
+      world->bricks[idx].rect = (Rect){
+          RealFromInt(PLAY_X) +
+              RealMul(RealFromInt(c), brick_w + RealFromInt(BRICK_GAP)),
+          RealFromInt(PLAY_Y) + REAL(40.0f) +
+              RealMul(RealFromInt(r), brick_h + RealFromInt(BRICK_GAP)),
+          brick_w, brick_h};
+      world->bricks[idx].home = world->bricks[idx].rect;
+      world->bricks[idx].motion = MOTION_NONE;
+    }
+  }
+  if (world->moving)
+    SetupMotion(world);
+  world->breakable_left = CountBreakable(world);
+
+  world->brick_bvh.root = -1;
+  if (!UseBrickBvh(world))
+    return;
+  Aabb boxes[MAX_BRICKS];
+  int scratch[MAX_BRICKS];
+  BrickBoxes(world, boxes);
+  BvhBuild(BrickBvh(world), boxes, MAX_BRICKS, BRICK_BVH_MARGIN, scratch);
+}
+
+void WorldInit(World *world, int level, uint32_t seed) {
+  memset(world, 0, sizeof(*world));
+  world->rng = seed != 0 ? seed : 0x9e3779b9u;
+  world->fx_rng = world->rng ^ 0x5bd1e995u;
+  world->level = level;
+  world->lives = 3;
+  world->paddle = (Rect){REAL(0.0f), REAL(PLAY_Y + PLAY_H - 40.0f),
+                         REAL(BASE_PADDLE_W), REAL(PADDLE_H)};
+  ResetPaddle(world);
+  InitLevel(world, level);
+  ResetBalls(world);
+}
+
+static void LoseLife(World *world) {
+  world->lives--;
+  if (world->lives <= 0) {
+    world->sfx |= SFX_LOSE;
+    world->status = WORLD_OVER;
+  }
+}
+
+_Static_assert(MAX_BRICKS <= 256 && MAX_MERGE_BALLS <= UINT16_MAX + 1,
+               "WorldEvent stores indices in uint8_t and uint16_t");
+
+// 空きは WorldMergeBalls が先に確かめている
+static void EmitEvent(EventBuffer *out, EventType type, int ball, int brick) {
+  out->events[out->count++] =
+      (WorldEvent){(uint8_t)type, (uint8_t)brick, (uint16_t)ball};
+}
+
+// 当たり判定の中で変えるのはブロックの耐久と生死だけ (後に動くボールが
+// 同じフレームで壊れたブロックに当たらないように). 残りは出来事として積む
+static void HitBrick(World *world, EventBuffer *out, int ball, int index) {
+  Brick *brick = &world->bricks[index];
+  if (!brick->solid)
+    brick->hp -= 1;
+  bool destroyed = !brick->solid && brick->hp <= 0;
+  if (destroyed)
+    brick->alive = false;
+  EmitEvent(out, destroyed ? EVENT_BRICK_DESTROYED : EVENT_BRICK_HIT, ball,
+            index);
+}
+
+static Vec2 BrickCenter(const Brick *brick) {
+  return (Vec2){brick->rect.x + RealMul(brick->rect.width, REAL(0.5f)),
+                brick->rect.y + RealMul(brick->rect.height, REAL(0.5f))};
+}
+
+// コンボは出来事の順に数える (パドルに当たった後に壊したブロックは 0 から)
+static void ScoreEvents(World *world, const WorldEvent *events, int count) {
+  for (int i = 0; i < count; i++) {
+    const WorldEvent *e = &events[i];
+    if (e->type == EVENT_PADDLE_HIT) {
+      world->combo = 0;
+    } else if (e->type == EVENT_BRICK_HIT) {
+      world->score += world->bricks[e->brick].solid ? 10 : 40;
+    } else if (e->type == EVENT_BRICK_DESTROYED) {
+      world->breakable_left--;
+      world->destroyed++;
+      world->score += 100 + world->combo * 30;
+      world->combo++;
+    }
+  }
+}
+
+static void FxEvents(World *world, const WorldEvent *events, int count) {
+  for (int i = 0; i < count; i++) {
+    const WorldEvent *e = &events[i];
+    if (e->type != EVENT_BRICK_DESTROYED)
+      continue;
+    const Brick *brick = &world->bricks[e->brick];
+    SpawnParticles(world, BrickCenter(brick), BrickColor(brick));
+    world->shake_time = 0.15f;
+    world->shake_mag = 6.0f;
+  }
+}
+
+static void SfxEvents(World *world, const WorldEvent *events, int count) {
+  static const unsigned int sfx_of[] = {
+      [EVENT_WALL_HIT] = SFX_HIT,
+      [EVENT_PADDLE_HIT] = SFX_HIT,
+      [EVENT_BRICK_HIT] = SFX_HIT,
+      [EVENT_BRICK_DESTROYED] = SFX_BREAK,
+      [EVENT_BALL_LOST] = 0,
+  };
+  for (int i = 0; i < count; i++)
+    world->sfx |= sfx_of[events[i].type];
+}
+
+static void PowerupEvents(World *world, const WorldEvent *events,
+                          int count) {
+  for (int i = 0; i < count; i++) {
+    const WorldEvent *e = &events[i];
+    if (e->type != EVENT_BRICK_DESTROYED)
+      continue;
+    const Brick *brick = &world->bricks[e->brick];
+    if (brick->power_brick)
+      SpawnPowerup(world, BrickCenter(brick), brick->power_type);
+  }
+}
+
+void WorldDispatchEvents(World *world, const WorldEvent *events, int count) {
+  ScoreEvents(world, events, count);
+  // 学習環境など描画しない用途では演出を丸ごと飛ばす
+  if (!world->no_fx)
+    FxEvents(world, events, count);
+  SfxEvents(world, events, count);
+  PowerupEvents(world, events, count);
+}
+
+static Real BallSpeed(const World *world) {
+  Real base_speed = RealMul(REAL(BALL_BASE_SPEED), LevelSpeedMult(world->level));
+  return RealMul(base_speed, SpeedItemMult(world->speed_state));
+}
+
+// 移動, 壁, 落下, パドル. 起きたことを CONTACT_* で返す
+static unsigned int MoveBall(const World *world, Ball *ball, Real speed,
+                             Real dt) {
+  Rect paddle = world->paddle;
+  unsigned int flags = 0;
+  if (ball->stuck) {
+    ball->pos.x = paddle.x + RealMul(paddle.width, REAL(0.5f));
+    ball->pos.y = paddle.y - ball->radius - REAL(2.0f);
+    return flags;
+  }
+
+  ball->pos.x += RealMul(RealMul(ball->vel.x, dt), speed);
+  ball->pos.y += RealMul(RealMul(ball->vel.y, dt), speed);
+
+  if (ball->pos.x - ball->radius < REAL(PLAY_X)) {
+    ball->pos.x = REAL(PLAY_X) + ball->radius;
+    ball->vel.x = -ball->vel.x;
+    flags |= CONTACT_WALL_LEFT;
+  }
+  if (ball->pos.x + ball->radius > REAL(PLAY_X + PLAY_W)) {
+    ball->pos.x = REAL(PLAY_X + PLAY_W) - ball->radius;
+    ball->vel.x = -ball->vel.x;
+    flags |= CONTACT_WALL_RIGHT;
+  }
+  if (ball->pos.y - ball->radius < REAL(PLAY_Y)) {
+    ball->pos.y = REAL(PLAY_Y) + ball->radius;
+    ball->vel.y = -ball->vel.y;
+    flags |= CONTACT_WALL_TOP;
+  }
+
+  if (ball->pos.y - ball->radius > REAL(PLAY_Y + PLAY_H)) {
+    ball->active = false;
+    flags |= CONTACT_LOST;
+  }
+
+  if (CircleHitsRect(ball->pos, ball->radius, paddle) &&
+      ball->vel.y > REAL(0.0f)) {
+    Real half_w = RealMul(paddle.width, REAL(0.5f));
+    Real hit = RealDiv(ball->pos.x - (paddle.x + half_w), half_w);
+    hit = ClampReal(hit, REAL(-1.0f), REAL(1.0f));
+    Real angle = RealMul(RealMul(hit, REAL(70.0f)), REAL(DEG2RAD));
+    ball->vel.x = RealSin(angle);
+    ball->vel.y = -RealCos(angle);
+    flags |= CONTACT_PADDLE;
+  }
+  return flags;
+}
+
+// 番号の一番小さい生きているブロックで跳ね返す. 木を使うときは BVH で
+// 候補を絞るが, 全ブロックを順に調べて最初に当たったものを取るのと
+// 同じ結果になる.
+// 当たったブロックの番号 (無ければ -1) と, 当たってから経った時間の
+// 見積もり (跳ね返す軸での重なり / 跳ね返す前のその軸の速さ) を返す
+static int BounceBrick(const World *world, Ball *ball, Real speed, Real dt,
+                       Real *elapsed) {
+  if (ball->stuck || !ball->active)
+    return -1;
+  int hit = -1;
+  if (UseBrickBvh(world)) {
+    int candidates[MAX_BRICKS];
+    Aabb ball_box = {RealToFloat(ball->pos.x - ball->radius),
+                     RealToFloat(ball->pos.y - ball->radius),
+                     RealToFloat(ball->pos.x + ball->radius),
+                     RealToFloat(ball->pos.y + ball->radius)};
+    int count = BvhQuery(world->brick_nodes, &world->brick_bvh, ball_box,
+                         candidates, MAX_BRICKS);
+    for (int i = 0; i < count; i++) {
+      int b = candidates[i];
+      if (hit >= 0 && b > hit)
+        continue;
+      const Brick *brick = &world->bricks[b];
+      if (brick->alive &&
+          CircleHitsRect(ball->pos, ball->radius, brick->rect))
+        hit = b;
+    }
+  } else {
+    for (int b = 0; b < MAX_BRICKS; b++) {
+      const Brick *brick = &world->bricks[b];
+      if (brick->alive &&
+          CircleHitsRect(ball->pos, ball->radius, brick->rect)) {
+        hit = b;
+        break;
+      }
+    }
+  }
+  if (hit < 0)
+    return -1;
+
+  const Brick *brick = &world->bricks[hit];
+  Real nearest_x = ClampReal(ball->pos.x, brick->rect.x,
+                             brick->rect.x + brick->rect.width);
+  Real nearest_y = ClampReal(ball->pos.y, brick->rect.y,
+                             brick->rect.y + brick->rect.height);
+  Real dx = ball->pos.x - nearest_x;
+  Real dy = ball->pos.y - nearest_y;
+  bool x_axis = RealAbs(dx) > RealAbs(dy);
+  Real p = x_axis ? ball->pos.x : ball->pos.y;
+  Real lo = x_axis ? brick->rect.x : brick->rect.y;
+  Real hi = lo + (x_axis ? brick->rect.width : brick->rect.height);
+  Real overlap_hi = p + ball->radius < hi ? p + ball->radius : hi;
+  Real overlap_lo = p - ball->radius > lo ? p - ball->radius : lo;
+  Real axis_vel = RealAbs(x_axis ? ball->vel.x : ball->vel.y);
+  if (axis_vel < REAL(MIN_AXIS_VEL))
+    axis_vel = REAL(MIN_AXIS_VEL);
+  *elapsed = RealDiv(overlap_hi - overlap_lo, RealMul(axis_vel, speed));
+  if (x_axis) {
+    ball->vel.x = -ball->vel.x;
+  } else {
+    ball->vel.y = -ball->vel.y;
+  }
+  ball->vel = NormalizeSafe(ball->vel);
+  ball->pos.x += RealMul(RealMul(ball->vel.x, dt), speed);
+  ball->pos.y += RealMul(RealMul(ball->vel.y, dt), speed);
+  return hit;
+}
+
+void WorldSolveBalls(const World *world, const Ball *balls,
+                     BallContact *contacts, int begin, int end, Real dt) {
+  Real speed = BallSpeed(world);
+  for (int i = begin; i < end; i++) {
+    BallContact *c = &contacts[i];
+    c->moved = balls[i];
+    c->flags = 0;
+    c->brick = -1;
+    c->elapsed = REAL(0.0f);
+    if (balls[i].active)
+      c->flags = (uint8_t)MoveBall(world, &c->moved, speed, dt);
+    c->bounced = c->moved;
+    c->brick = BounceBrick(world, &c->bounced, speed, dt, &c->elapsed);
+  }
+}
+
+static void EmitContactEvents(EventBuffer *out, int ball, unsigned int flags) {
+  if (flags & CONTACT_WALL_LEFT)
+    EmitEvent(out, EVENT_WALL_HIT, ball, 0);
+  if (flags & CONTACT_WALL_RIGHT)
+    EmitEvent(out, EVENT_WALL_HIT, ball, 0);
+  if (flags & CONTACT_WALL_TOP)
+    EmitEvent(out, EVENT_WALL_HIT, ball, 0);
+  if (flags & CONTACT_LOST)
+    EmitEvent(out, EVENT_BALL_LOST, ball, 0);
+  if (flags & CONTACT_PADDLE)
+    EmitEvent(out, EVENT_PADDLE_HIT, ball, 0);
+}
+
+int WorldMergeBalls(World *world, Ball *balls, const BallContact *contacts,
+                    int count, Real dt, EventBuffer *out) {
+  if (count > MAX_MERGE_BALLS ||
+      (long)out->capacity - out->count < (long)count * EVENTS_PER_BALL)
+    return -1;
+
+  // 壊せるブロックごとに当てるボールを1つ選ぶ (先に当たった方, 同じなら
+  // ボール番号の小さい方). 壊せないブロックは何個当たっても状態が変わらない
+  // ので全員通す
+  int owner[MAX_BRICKS];
+  for (int b = 0; b < MAX_BRICKS; b++)
+    owner[b] = -1;
+  for (int i = 0; i < count; i++) {
+    int b = contacts[i].brick;
+    if (b < 0 || world->bricks[b].solid)
+      continue;
+    if (owner[b] < 0 || contacts[i].elapsed > contacts[owner[b]].elapsed)
+      owner[b] = i;
+  }
+
+  int conflicts = 0;
+  for (int i = 0; i < count; i++) {
+    const BallContact *c = &contacts[i];
+    EmitContactEvents(out, i, c->flags);
+    int b = c->brick;
+    if (b >= 0 && !world->bricks[b].solid && owner[b] != i) {
+      conflicts++;
+      continue;
+    }
+    balls[i] = c->bounced;
+    if (b >= 0)
+      HitBrick(world, out, i, b);
+  }
+  if (conflicts == 0)
+    return 0;
+
+  // 負けたボールは壁とパドルまで進めた状態から, 更新後のブロックに対して
+  // 番号順に当たり直す
+  Real speed = BallSpeed(world);
+  for (int i = 0; i < count; i++) {
+    const BallContact *c = &contacts[i];
+    int b = c->brick;
+    if (b < 0 || world->bricks[b].solid || owner[b] == i)
+      continue;
+    Real elapsed;
+    balls[i] = c->moved;
+    int hit = BounceBrick(world, &balls[i], speed, dt, &elapsed);
+    if (hit >= 0)
+      HitBrick(world, out, i, hit);
+  }
+  return conflicts;
+}
+
+static void ApplyPowerup(World *world, PowerType type) {
+  world->sfx |= SFX_POWER;
+  if (type == POWER_EXTEND) {
+    world->paddle_target_w = REAL(BASE_PADDLE_W * 1.6f);
+  } else if (type == POWER_MULTIBALL) {
+    for (int b = 0; b < MAX_BALLS; b++) {
+      Ball *ball = &world->balls[b];
+      if (!ball->active) {
+        ball->active = true;
+        ball->stuck = false;
+        ball->pos =
+            (Vec2){world->paddle.x + RealMul(world->paddle.width, REAL(0.5f)),
+                   world->paddle.y - REAL(20.0f)};
+        LaunchBall(world, ball);
+      }
+    }
+  } else if (type == POWER_SLOW) {
+    world->speed_state = -1;
+    world->speed_timer = REAL(10.0f);
+  } else if (type == POWER_LIFE) {
+    world->lives++;
+  } else if (type == POWER_FAST) {
+    world->speed_state = 1;
+    world->speed_timer = REAL(10.0f);
+  } else if (type == POWER_DEATH) {
+    LoseLife(world);
+  }
+}
+
+static void UpdateParticles(World *world, Real dt) {
+  for (int i = 0; i < MAX_PARTICLES; i++) {
+    Particle *p = &world->particles[i];
+    if (!p->active)
+      continue;
+    p->life -= dt;
+    if (p->life <= REAL(0.0f)) {
+      p->active = false;
+      continue;
+    }
+    p->pos.x += RealMul(p->vel.x, dt);
+    p->pos.y += RealMul(p->vel.y, dt);
+    p->vel.y += RealMul(REAL(120.0f), dt);
+  }
+}
+
+void WorldStep(World *world, uint8_t input, float frame_dt) {
+  Real dt = RealFromFloat(frame_dt);
+  world->sfx = 0;
+  world->destroyed = 0;
+  world->event_count = 0;
+  if (world->status != WORLD_PLAY)
+    return;
+
+  bool any_stuck = false;
+  for (int i = 0; i < MAX_BALLS; i++) {
+    if (world->balls[i].active && world->balls[i].stuck) {
+      any_stuck = true;
+      break;
+    }
+  }
+
+  Rect *paddle = &world->paddle;
+  if (!any_stuck) {
+    Real move = REAL(0.0f);
+    if (input & INPUT_LEFT)
+      move -= REAL(1.0f);
+    if (input & INPUT_RIGHT)
+      move += REAL(1.0f);
+    paddle->x += RealMul(RealMul(move, REAL(PADDLE_SPEED)), dt);
+    paddle->x = ClampReal(paddle->x, REAL(PLAY_X),
+                          REAL(PLAY_X + PLAY_W) - paddle->width);
+
+    paddle->width += RealMul(
+        RealMul(world->paddle_target_w - paddle->width, REAL(8.0f)), dt);
+    paddle->x = ClampReal(paddle->x, REAL(PLAY_X),
+                          REAL(PLAY_X + PLAY_W) - paddle->width);
+  }
+
+  if (world->moving)
+    MoveBricks(world, dt);
+
+  if (input & INPUT_LAUNCH) {
+    for (int i = 0; i < MAX_BALLS; i++) {
+      if (world->balls[i].active && world->balls[i].stuck) {
+        LaunchBall(world, &world->balls[i]);
+      }
+    }
+  }
+
+  BallContact contacts[MAX_BALLS];
+  WorldSolveBalls(world, world->balls, contacts, 0, MAX_BALLS, dt);
+  EventBuffer events = {world->events, 0, MAX_EVENTS};
+  WorldMergeBalls(world, world->balls, contacts, MAX_BALLS, dt, &events);
+  world->event_count = events.count;
+  WorldDispatchEvents(world, world->events, world->event_count);
+
+  bool any_ball = false;
+  for (int i = 0; i < MAX_BALLS; i++) {
+    if (world->balls[i].active) {
+      any_ball = true;
+      break;
+    }
+  }
+  if (!any_ball) {
+    world->combo = 0;
+    LoseLife(world);
+    if (world->status == WORLD_PLAY) {
+      ResetBalls(world);
+      ResetPaddle(world);
+      world->speed_state = 0;
+      world->speed_timer = REAL(0.0f);
+    }
+  }
+
+  for (int i = 0; i < MAX_POWERUPS; i++) {
+    Powerup *p = &world->powerups[i];
+    if (!p->active)
+      continue;
+    if (!any_stuck) {
+      p->pos.y += RealMul(p->vel.y, dt);
+    }
+    if (p->pos.y - p->radius > REAL(PLAY_Y + PLAY_H)) {
+      p->active = false;
+      continue;
+    }
+    if (CircleHitsRect(p->pos, p->radius, *paddle)) {
+      p->active = false;
+      ApplyPowerup(world, p->type);
+    }
+  }
+
+  if (world->speed_timer > REAL(0.0f)) {
+    world->speed_timer -= dt;
+    if (world->speed_timer <= REAL(0.0f)) {
+      world->speed_timer = REAL(0.0f);
+      world->speed_state = 0;
+    }
+  }
+
+  if (!world->no_fx)
+    UpdateParticles(world, dt);
+
+  if (world->status == WORLD_PLAY && world->breakable_left <= 0) {
+    world->status = WORLD_CLEAR;
+    world->sfx |= SFX_CLEAR;
+  }
+}
+
+// 対戦相手から送られたお邪魔ブロック.
+// 既存の段を1段ずつ下げ, 最上段に乱数で穴の開いた段を追加する.
+// 最下段に残っていたブロックは押し出され, その代わりにライフを1つ失う.
+void WorldAddGarbage(World *world, int rows) {
+  for (int n = 0; n < rows && world->status == WORLD_PLAY; n++) {
+    bool overflow = false;
+    for (int c = 0; c < BRICK_COLS; c++) {
+      if (world->bricks[(BRICK_ROWS - 1) * BRICK_COLS + c].alive)
+        overflow = true;
+    }
+    for (int r = BRICK_ROWS - 1; r > 0; r--) {
+      for (int c = 0; c < BRICK_COLS; c++) {
+        Brick *dst = &world->bricks[r * BRICK_COLS + c];
+        const Brick *src = &world->bricks[(r - 1) * BRICK_COLS + c];
+        // 種類と耐久だけを移し, 位置と動きはその段のものを残す
+        dst->hp = src->hp;
+        dst->max_hp = src->max_hp;
+        dst->alive = src->alive;
+        dst->solid = src->solid;
+        dst->power_brick = src->power_brick;
+        dst->power_type = src->power_type;
+      }
+    }
+    for (int c = 0; c < BRICK_COLS; c++) {
+      int roll = RandomRange(&world->rng, 0, 11);
+      int val = roll < 3 ? 0 : (roll < 5 ? 8 : 1);
+      SetBrickType(&world->bricks[c], val);
+    }
+    world->breakable_left = CountBreakable(world);
+    if (overflow)
+      LoseLife(world);
+  }
+}
+
+static uint64_t HashBytes(uint64_t hash, const void *data, size_t len) {
+  const unsigned char *p = data;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= p[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static uint64_t HashInt(uint64_t hash, int32_t v) {
+  return HashBytes(hash, &v, sizeof(v));
+}
+
+// 固定小数点ならそのままの整数, float ならビット列をハッシュする
+static uint64_t HashReal(uint64_t hash, Real v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return HashBytes(hash, &bits, sizeof(bits));
+}
+
+// ゲーム進行に関わる状態だけをハッシュする (パーティクルや画面揺れは除く).
+// 構造体を丸ごとハッシュしないのはパディングの中身が不定なため.
+uint64_t WorldHash(const World *world, uint64_t hash) {
+  if (hash == 0)
+    hash = 0xcbf29ce484222325ull;
+  hash = HashReal(hash, world->paddle.x);
+  hash = HashReal(hash, world->paddle.width);
+  for (int i = 0; i < MAX_BALLS; i++) {
+    const Ball *b = &world->balls[i];
+    hash = HashInt(hash, b->active | (b->stuck << 1));
+    if (!b->active)
+      continue;
+    hash = HashReal(hash, b->pos.x);
+    hash = HashReal(hash, b->pos.y);
+    hash = HashReal(hash, b->vel.x);
+    hash = HashReal(hash, b->vel.y);
+  }
+  for (int i = 0; i < MAX_BRICKS; i++) {
+    const Brick *b = &world->bricks[i];
+    hash = HashInt(hash, b->alive | (b->solid << 1) | (b->power_brick << 2) |
+                             ((int)b->power_type << 3) | (b->hp << 8));
+  }
+  for (int i = 0; i < MAX_POWERUPS; i++) {
+    const Powerup *p = &world->powerups[i];
+    hash = HashInt(hash, p->active | ((int)p->type << 1));
+    if (p->active)
+      hash = HashReal(hash, p->pos.y);
+  }
+  hash = HashInt(hash, world->status);
+  hash = HashInt(hash, world->score);
+  hash = HashInt(hash, world->lives);
+  hash = HashInt(hash, world->combo);
+  hash = HashInt(hash, world->speed_state);
+  hash = HashReal(hash, world->speed_timer);
+  hash = HashReal(hash, world->time);
+  hash = HashInt(hash, (int32_t)world->rng);
+  return hash;
+}
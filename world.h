@@ -0,0 +1,262 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bvh.h"
+#include "real.h"
+
+// 座標はすべて画面 (SCREEN_W x SCREEN_H) 上のピクセル
+#define SCREEN_W 1000
+#define SCREEN_H 800
+
+#define PLAY_X 70
+#define PLAY_Y 90
+#define PLAY_W 860
+#define PLAY_H 640
+
+#define BRICK_ROWS 8
+#define BRICK_COLS 12
+#define BRICK_GAP 6
+
+#define MAX_BRICKS (BRICK_ROWS * BRICK_COLS)
+// ブロックがこの数以上で, しかも動く面でだけ当たり判定に BVH を使う.
+// tools/bvh_bench (ボール 512 個) では 96 個で総当たりの 0.5 倍,
+// 256 個で 0.8 倍と遅く, 1024 個から速くなる. ボールが数個なら
+// 16384 個でも総当たりの方が速い
+#define BRICK_BVH_MIN_BRICKS 1024
+#define MAX_BALLS 4
+#define MAX_POWERUPS 6
+#define MAX_PARTICLES 220
+
+#define BASE_PADDLE_W 120.0f
+#define PADDLE_H 16.0f
+#define PADDLE_SPEED 520.0f
+#define BALL_RADIUS 8.0f
+#define BALL_BASE_SPEED 430.0f
+
+#ifndef PI
+#define PI 3.14159265358979323846f
+#endif
+#ifndef DEG2RAD
+#define DEG2RAD (PI / 180.0f)
+#endif
+
+// レベル番号 1-3 は通常プレイ, 4 はブロックが動く面,
+// 5 は対戦用の上部が空いた配置
+#define LEVEL_MOVING 4
+#define LEVEL_VERSUS 5
+
+// 1フレーム分の入力 (ネットワーク越しに送るのでビット列にしている)
+#define INPUT_LEFT 0x1
+#define INPUT_RIGHT 0x2
+#define INPUT_LAUNCH 0x4
+#define INPUT_MASK 0x7
+
+// WorldStep 中に鳴らすべき効果音
+#define SFX_HIT 0x1
+#define SFX_BREAK 0x2
+#define SFX_POWER 0x4
+#define SFX_LOSE 0x8
+#define SFX_CLEAR 0x10
+
+typedef struct {
+  Real x;
+  Real y;
+} Vec2;
+
+typedef struct {
+  Real x;
+  Real y;
+  Real width;
+  Real height;
+} Rect;
+
+// raylib の Color と同じ並び
+typedef struct {
+  unsigned char r;
+  unsigned char g;
+  unsigned char b;
+  unsigned char a;
+} Rgba;
+
+typedef enum { WORLD_PLAY = 0, WORLD_CLEAR, WORLD_OVER } WorldStatus;
+
+typedef enum {
+  POWER_EXTEND = 0,
+  POWER_MULTIBALL,
+  POWER_SLOW,
+  POWER_LIFE,
+  POWER_FAST,
+  POWER_DEATH
+} PowerType;
+
+typedef struct {
+  Vec2 pos;
+  Vec2 vel;
+  Real radius;
+  bool active;
+  bool stuck;
+} Ball;
+
+typedef enum {
+  MOTION_NONE = 0,
+  // 横に往復する (amp が負なら逆向きから始まる)
+  MOTION_SLIDE,
+  // 元の位置のまわりを半径 amp で回る
+  MOTION_ORBIT,
+  // 隊列ごと pivot を中心に回転する (ブロック自体は傾けない)
+  MOTION_ROTATE
+} BrickMotion;
+
+typedef struct {
+  Rect rect;
+  // 動くブロックの基準位置
+  Rect home;
+  BrickMotion motion;
+  Real amp;
+  Real phase;
+  Vec2 pivot;
+  int hp;
+  int max_hp;
+  bool alive;
+  bool solid;
+  bool power_brick;
+  PowerType power_type;
+} Brick;
+
+typedef struct {
+  Vec2 pos;
+  Vec2 vel;
+  Real radius;
+  PowerType type;
+  bool active;
+} Powerup;
+
+typedef struct {
+  Vec2 pos;
+  Vec2 vel;
+  Real life;
+  Rgba color;
+  bool active;
+} Particle;
+
+// ボールの当たり判定が出す出来事. 判定のループでは記録するだけにして,
+// 得点・演出・効果音・アイテムはフレームごとにまとめて処理する.
+typedef enum {
+  EVENT_WALL_HIT = 0,
+  EVENT_PADDLE_HIT,
+  // 壊れなかった (壊せないブロックか耐久が残った)
+  EVENT_BRICK_HIT,
+  EVENT_BRICK_DESTROYED,
+  EVENT_BALL_LOST,
+} EventType;
+
+typedef struct {
+  uint8_t type;
+  // EVENT_BRICK_* のときのブロック番号
+  uint8_t brick;
+  // WorldMergeBalls に渡したボール配列での番号
+  uint16_t ball;
+} WorldEvent;
+
+// 出来事を積む先. WorldStep は World の events を使う. ボールを多く扱う
+// 呼び出し側は count * EVENTS_PER_BALL 個分の配列を自分で用意する
+typedef struct {
+  WorldEvent *events;
+  int count;
+  int capacity;
+} EventBuffer;
+
+// ボール1個の1ステップ分の当たり判定 (WorldSolveBalls が書き,
+// WorldMergeBalls が読む)
+#define CONTACT_WALL_LEFT 0x1
+#define CONTACT_WALL_RIGHT 0x2
+#define CONTACT_WALL_TOP 0x4
+#define CONTACT_LOST 0x8
+#define CONTACT_PADDLE 0x10
+
+typedef struct {
+  // 壁とパドルまで処理した状態と, そこからブロックで跳ね返した状態
+  Ball moved;
+  Ball bounced;
+  // 当たったブロック (-1: 無し) と, 当たってから経った時間の見積もり
+  // (秒. 長いほど先に当たった)
+  int brick;
+  Real elapsed;
+  uint8_t flags;
+} BallContact;
+
+// ボール1個が1フレームで出すのは CONTACT_* の 5 つ + ブロック1つまで
+#define EVENTS_PER_BALL 8
+#define MAX_EVENTS (MAX_BALLS * EVENTS_PER_BALL)
+// WorldEvent.ball に入る番号の上限
+#define MAX_MERGE_BALLS 65536
+
+// 1人分のプレイフィールド. 描画や音声には依存しない.
+typedef struct {
+  Rect paddle;
+  Real paddle_target_w;
+  Ball balls[MAX_BALLS];
+  Brick bricks[MAX_BRICKS];
+  Powerup powerups[MAX_POWERUPS];
+  Particle particles[MAX_PARTICLES];
+  WorldStatus status;
+  int level;
+  int breakable_left;
+  int score;
+  int lives;
+  int combo;
+  int speed_state;
+  Real speed_timer;
+  float shake_time;
+  float shake_mag;
+  // 経過時間. 動くブロックの位置はこれから決まる
+  Real time;
+  bool moving;
+  // ブロックの当たり判定用 BVH (全スロット分. 壊れたブロックは検索後に除く)
+  BvhNode brick_nodes[2 * MAX_BRICKS];
+  int brick_leaf[MAX_BRICKS];
+  BvhInfo brick_bvh;
+  uint32_t rng;
+  // 描画しない用途 (学習環境など) ではパーティクルを出さない
+  bool no_fx;
+  // パーティクル用の乱数.
+  // ゲーム進行用と分けておくと演出の有無で結果が変わらない
+  uint32_t fx_rng;
+  // 直前の WorldStep の結果
+  unsigned int sfx;
+  int destroyed;
+  WorldEvent events[MAX_EVENTS];
+  int event_count;
+} World;
+
+Rgba BrickColor(const Brick *brick);
+Rgba PowerupColor(PowerType type);
+char PowerupLabel(PowerType type);
+
+void WorldInit(World *world, int level, uint32_t seed);
+void WorldStep(World *world, uint8_t input, float dt);
+// WorldStep の中で, ボールを動かした直後に呼ばれる. events を得点・演出・
+// 効果音・アイテムの順に処理する (計測用に公開している).
+void WorldDispatchEvents(World *world, const WorldEvent *events, int count);
+// ボールの移動と当たり判定の前半. world と balls は読むだけで
+// contacts[begin, end) にだけ書くので, 範囲を分けて並列に呼んでよい.
+void WorldSolveBalls(const World *world, const Ball *balls,
+                     BallContact *contacts, int begin, int end, Real dt);
+// 後半 (直列). ボール番号順に結果を反映し, 出来事を積む. 同じ壊せる
+// ブロックに複数のボールが当たったときは, 先に当たった方 (elapsed が
+// 長い方. 同じなら番号の小さい方) だけが当たり, 残りは更新後の
+// ブロックに対して番号順に当たり直す. どちらもスレッド数によらず同じ
+// 結果になる.
+// 出来事は out に積む. out に count * EVENTS_PER_BALL 個の空きが無いか,
+// count が MAX_MERGE_BALLS を超えるときは何もせず -1 を返す
+// (ブロックを壊したのに出来事が落ちて得点や残り数がずれないように).
+// それ以外は当たり直したボールの数を返す.
+int WorldMergeBalls(World *world, Ball *balls, const BallContact *contacts,
+                    int count, Real dt, EventBuffer *out);
+void WorldAddGarbage(World *world, int rows);
+uint64_t WorldHash(const World *world, uint64_t hash);
+
+#endif